@@ -167,6 +167,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -521,6 +522,10 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_THREADS
+    free_encoder_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -645,6 +650,7 @@ static void ffmpeg_cleanup(int ret)
     }
     av_freep(&vstats_filename);
     av_freep(&filter_nbthreads);
+    av_freep(&filter_complex_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -784,9 +790,10 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
         ost->pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
 
         for (i = 0; i<FF_ARRAY_ELEMS(ost->error); i++) {
-            if (sd && i < sd[5])
+            if (sd && i < sd[5]) {
                 ost->error[i] = AV_RL64(sd + 8 + 8*i);
-            else
+                ost->error_sum[i] += ost->error[i];
+            } else
                 ost->error[i] = -1;
         }
 
@@ -993,6 +1000,237 @@ static int init_output_stream_wrapper(OutputStream *ost, AVFrame *frame,
     return ret;
 }
 
+#if HAVE_THREADS
+static void free_frame_msg(void *msg)
+{
+    av_frame_free(msg);
+}
+
+/*
+ * Encode the frames queued by the main thread and queue the resulting
+ * packets back for muxing. Muxing, bitstream filtering and error handling
+ * all stay on the main thread.
+ */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket *pkt;
+    AVFrame *frame;
+    int64_t pts;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(ost->enc_frame_queue, &frame, 0);
+        if (ret < 0)
+            break;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        pts = frame->pts;
+        ret = avcodec_send_frame(enc, frame);
+        av_frame_free(&frame);
+        if (ret < 0)
+            break;
+
+        while (1) {
+            pkt = av_packet_alloc();
+            if (!pkt) {
+                ret = AVERROR(ENOMEM);
+                goto finish;
+            }
+            ret = avcodec_receive_packet(enc, pkt);
+            if (ret < 0) {
+                av_packet_free(&pkt);
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                goto finish;
+            }
+
+            if (enc->codec_type == AVMEDIA_TYPE_VIDEO && pkt->pts == AV_NOPTS_VALUE &&
+                !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt->pts = pts;
+
+            if (debug_ts) {
+                av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                       av_get_media_type_string(enc->codec_type),
+                       av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+                       av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+            }
+
+            av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+
+            /* if two pass, output log */
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            pthread_mutex_lock(&ost->enc_pkt_lock);
+            ret = av_fifo_write(ost->enc_pkt_queue, &pkt, 1);
+            pthread_cond_signal(&ost->enc_pkt_cond);
+            pthread_mutex_unlock(&ost->enc_pkt_lock);
+            if (ret < 0) {
+                av_packet_free(&pkt);
+                goto finish;
+            }
+        }
+    }
+
+finish:
+    av_thread_message_queue_set_err_send(ost->enc_frame_queue, ret);
+    pthread_mutex_lock(&ost->enc_pkt_lock);
+    ost->enc_thread_ret  = ret;
+    ost->enc_thread_done = 1;
+    pthread_cond_signal(&ost->enc_pkt_cond);
+    pthread_mutex_unlock(&ost->enc_pkt_lock);
+    return NULL;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&ost->enc_frame_queue, enc_thread_queue_size,
+                                        sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(ost->enc_frame_queue, free_frame_msg);
+
+    ost->enc_pkt_queue = av_fifo_alloc2(enc_thread_queue_size, sizeof(AVPacket *),
+                                        AV_FIFO_FLAG_AUTO_GROW);
+    if (!ost->enc_pkt_queue) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ost->enc_thread_done = 0;
+    ost->enc_thread_ret  = 0;
+    pthread_mutex_init(&ost->enc_pkt_lock, NULL);
+    pthread_cond_init(&ost->enc_pkt_cond, NULL);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_mutex_destroy(&ost->enc_pkt_lock);
+        pthread_cond_destroy(&ost->enc_pkt_cond);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_thread_message_queue_free(&ost->enc_frame_queue);
+    av_fifo_freep2(&ost->enc_pkt_queue);
+    return ret;
+}
+
+/*
+ * Mux the packets returned by the encoder thread of ost. If flush is set,
+ * wait until the encoder thread has finished, otherwise only take what is
+ * already available.
+ */
+static void receive_encoder_thread_packets(OutputFile *of, OutputStream *ost, int flush)
+{
+    AVPacket *pkt;
+    int done, ret;
+
+    pthread_mutex_lock(&ost->enc_pkt_lock);
+    while (1) {
+        while (av_fifo_read(ost->enc_pkt_queue, &pkt, 1) >= 0) {
+            int pkt_size = pkt->size;
+
+            pthread_mutex_unlock(&ost->enc_pkt_lock);
+            output_packet(of, pkt, ost, 0);
+            av_packet_free(&pkt);
+
+            if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename && pkt_size)
+                do_video_stats(ost, pkt_size);
+            pthread_mutex_lock(&ost->enc_pkt_lock);
+        }
+        if (!flush || ost->enc_thread_done)
+            break;
+        pthread_cond_wait(&ost->enc_pkt_cond, &ost->enc_pkt_lock);
+    }
+    done = ost->enc_thread_done;
+    ret  = ost->enc_thread_ret;
+    pthread_mutex_unlock(&ost->enc_pkt_lock);
+
+    if (done && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(ost->enc_ctx->codec_type), av_err2str(ret));
+        exit_program(1);
+    }
+}
+
+static void send_encoder_thread_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *queue_frame;
+    int ret;
+
+    if (!ost->enc_frame_queue && init_encoder_thread(ost) < 0)
+        exit_program(1);
+
+    queue_frame = av_frame_clone(frame);
+    if (!queue_frame)
+        exit_program(1);
+
+    /* The packet queue grows as needed, so the encoder thread is never
+     * stuck waiting for us and blocking here cannot deadlock. */
+    ret = av_thread_message_queue_send(ost->enc_frame_queue, &queue_frame, 0);
+    if (ret < 0) {
+        av_frame_free(&queue_frame);
+        receive_encoder_thread_packets(of, ost, 1);
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(ost->enc_ctx->codec_type), av_err2str(ret));
+        exit_program(1);
+    }
+
+    receive_encoder_thread_packets(of, ost, 0);
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    AVPacket *pkt;
+
+    if (!ost || !ost->enc_frame_queue)
+        return;
+
+    av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+    av_thread_message_flush(ost->enc_frame_queue);
+
+    pthread_join(ost->enc_thread, NULL);
+    while (av_fifo_read(ost->enc_pkt_queue, &pkt, 1) >= 0)
+        av_packet_free(&pkt);
+
+    av_thread_message_queue_free(&ost->enc_frame_queue);
+    av_fifo_freep2(&ost->enc_pkt_queue);
+    pthread_mutex_destroy(&ost->enc_pkt_lock);
+    pthread_cond_destroy(&ost->enc_pkt_cond);
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        free_encoder_thread(output_streams[i]);
+}
+
+/*
+ * Let the encoder thread of ost encode all the frames queued so far, mux
+ * its packets and stop it. The encoder can then be flushed normally.
+ */
+static void finish_encoder_thread(OutputStream *ost)
+{
+    if (!ost->enc_frame_queue)
+        return;
+
+    av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+    receive_encoder_thread_packets(output_files[ost->file_index], ost, 1);
+    free_encoder_thread(ost);
+}
+#endif
+
 static void do_audio_out(OutputFile *of, OutputStream *ost,
                          AVFrame *frame)
 {
@@ -1011,6 +1249,13 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     ost->samples_encoded += frame->nb_samples;
     ost->frames_encoded++;
 
+#if HAVE_THREADS
+    if (enc_thread_queue_size > 0) {
+        send_encoder_thread_frame(of, ost, frame);
+        return;
+    }
+#endif
+
     update_benchmark(NULL);
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
@@ -1344,45 +1589,53 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
-        if (ret < 0)
-            goto error;
-        // Make sure Closed Captions will not be duplicated
-        av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
+#if HAVE_THREADS
+        if (enc_thread_queue_size > 0) {
+            send_encoder_thread_frame(of, ost, in_picture);
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
+        } else
+#endif
+        {
+            ret = avcodec_send_frame(enc, in_picture);
             if (ret < 0)
                 goto error;
+            // Make sure Closed Captions will not be duplicated
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
-                       av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
-            }
+            while (1) {
+                ret = avcodec_receive_packet(enc, pkt);
+                update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                if (ret < 0)
+                    goto error;
+
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                           "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                           av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &enc->time_base),
+                           av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &enc->time_base));
+                }
 
-            if (pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt->pts = ost->sync_opts;
+                if (pkt->pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                    pkt->pts = ost->sync_opts;
 
-            av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+                av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ost->mux_timebase),
-                    av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ost->mux_timebase));
-            }
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                        "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                        av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ost->mux_timebase),
+                        av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ost->mux_timebase));
+                }
 
-            frame_size = pkt->size;
-            output_packet(of, pkt, ost, 0);
+                frame_size = pkt->size;
+                output_packet(of, pkt, ost, 0);
 
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
+                /* if two pass, output log */
+                if (ost->logfile && enc->stats_out) {
+                    fprintf(ost->logfile, "%s", enc->stats_out);
+                }
             }
         }
         ost->sync_opts++;
@@ -1525,7 +1778,8 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                /* with an encoder thread running, this is done by the thread */
+                if (!ost->frame_aspect_ratio.num && !ost->enc_frame_queue)
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 do_video_out(of, ost, filtered_frame);
@@ -1546,6 +1800,11 @@ static int reap_filters(int flush)
 
             av_frame_unref(filtered_frame);
         }
+
+#if HAVE_THREADS
+        if (ost->enc_pkt_queue)
+            receive_encoder_thread_packets(of, ost, 0);
+#endif
     }
 
     return 0;
@@ -1755,7 +2014,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                 av_bprintf(&buf, "PSNR=");
                 for (j = 0; j < 3; j++) {
                     if (is_last_report) {
-                        error = enc->error[j];
+                        /* enc->error belongs to the encoder thread, if any */
+                        error = enc_thread_queue_size > 0 ? ost->error_sum[j] : enc->error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0 * frame_number;
                     } else {
                         error = ost->error[j];
@@ -1895,6 +2155,11 @@ static void flush_encoders(void)
 {
     int i, ret;
 
+#if HAVE_THREADS
+    for (i = 0; i < nb_output_streams; i++)
+        finish_encoder_thread(output_streams[i]);
+#endif
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream   *ost = output_streams[i];
         AVCodecContext *enc = ost->enc_ctx;
@@ -4756,6 +5021,7 @@ static int transcode(void)
  fail:
 #if HAVE_THREADS
     free_input_threads();
+    free_encoder_threads();
 #endif
 
     if (output_streams) {
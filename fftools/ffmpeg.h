@@ -573,6 +573,20 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    /* encoder thread, see -enc_thread_queue_size */
+    AVThreadMessageQueue *enc_frame_queue; /* frames waiting to be encoded */
+    AVFifo *enc_pkt_queue;      /* encoded packets waiting to be muxed, grows
+                                   so that the encoder thread never blocks */
+    pthread_mutex_t enc_pkt_lock;
+    pthread_cond_t enc_pkt_cond;
+    int enc_thread_done;        /* set by the encoder thread when it exits */
+    int enc_thread_ret;         /* why it exited, AVERROR_EOF when done */
+    pthread_t enc_thread;
+
+    /* sum of the error values of all packets, used instead of
+     * enc_ctx->error when an encoder thread writes the latter */
+    int64_t error_sum[4];
 } OutputStream;
 
 typedef struct OutputFile {
@@ -633,6 +647,8 @@ extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_complex_thread_type;
+extern int enc_thread_queue_size;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
@@ -1019,6 +1019,11 @@ int configure_filtergraph(FilterGraph *fg)
         av_opt_set(fg->graph, "aresample_swr_opts", args, 0);
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
+        if (filter_complex_thread_type) {
+            ret = av_opt_set(fg->graph, "thread_type", filter_complex_thread_type, 0);
+            if (ret < 0)
+                goto fail;
+        }
     }
 
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
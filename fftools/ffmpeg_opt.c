@@ -165,6 +165,8 @@ int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+char *filter_complex_thread_type;
+int enc_thread_queue_size = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
@@ -3659,6 +3661,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_complex_thread_type", HAS_ARG | OPT_STRING | OPT_EXPERT, { &filter_complex_thread_type },
+        "thread types allowed for -filter_complex", "flags" },
+    { "enc_thread_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,      { &enc_thread_queue_size },
+        "run every encoder in its own thread with this many queued frames", "size" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -2686,6 +2686,183 @@ static void er_add_slice(H264SliceContext *sl,
     }
 }
 
+#if HAVE_THREADS
+static void recon_copy_coeffs(const H264Context *h, int16_t *dst, int16_t *src,
+                              int clear_src)
+{
+    const int pixel_shift = h->pixel_shift;
+
+    for (int p = 0; p < 3; p++) {
+        const int offset = 16 * 16 * p << pixel_shift;
+        const int size   = (p && !CHROMA444(h) ? 64 << CHROMA422(h) : 256) *
+                           sizeof(*dst) << pixel_shift;
+
+        memcpy(dst + offset, src + offset, size);
+        if (clear_src)
+            memset(src + offset, 0, size);
+    }
+}
+
+/* Called with the mutex locked, returns with it locked. */
+static void recon_next_row(const H264Context *h, H264ReconPipe *pipe)
+{
+    H264SliceContext *rsl   = &h->slice_ctx[1];
+    const int slot          = pipe->nb_reconstructed % H264_RECON_ROWS;
+    const H264ReconRow *row = &pipe->rows[slot];
+    const int coeffs_size   = 16 * 48 << h->pixel_shift;
+
+    pipe->busy = 1;
+    pthread_mutex_unlock(&pipe->mutex);
+
+    for (int mb_x = row->start_x; mb_x < row->end_x; mb_x++) {
+        const int idx = slot * h->mb_width + mb_x;
+        const H264ReconMB *mb = &pipe->mbs[idx];
+
+        rsl->mb_x  = mb_x;
+        rsl->mb_y  = row->mb_y;
+        rsl->mb_xy = mb_x + row->mb_y * h->mb_stride;
+
+        rsl->intra_pcm_ptr              = mb->intra_pcm_ptr;
+        rsl->qscale                     = mb->qscale;
+        rsl->chroma_qp[0]               = mb->chroma_qp[0];
+        rsl->chroma_qp[1]               = mb->chroma_qp[1];
+        rsl->cbp                        = mb->cbp;
+        rsl->top_type                   = mb->top_type;
+        rsl->chroma_pred_mode           = mb->chroma_pred_mode;
+        rsl->intra16x16_pred_mode       = mb->intra16x16_pred_mode;
+        rsl->topleft_samples_available  = mb->topleft_samples_available;
+        rsl->topright_samples_available = mb->topright_samples_available;
+        memcpy(rsl->intra4x4_pred_mode_cache, mb->intra4x4_pred_mode_cache,
+               sizeof(rsl->intra4x4_pred_mode_cache));
+        memcpy(rsl->non_zero_count_cache, mb->non_zero_count_cache,
+               sizeof(rsl->non_zero_count_cache));
+        memcpy(rsl->mv_cache,    mb->mv_cache,    sizeof(rsl->mv_cache));
+        memcpy(rsl->ref_cache,   mb->ref_cache,   sizeof(rsl->ref_cache));
+        memcpy(rsl->sub_mb_type, mb->sub_mb_type, sizeof(rsl->sub_mb_type));
+        memcpy(rsl->mb_luma_dc,  mb->mb_luma_dc,  sizeof(rsl->mb_luma_dc));
+        /* the coefficients are cleared by the reconstruction */
+        if (mb->has_coeffs)
+            recon_copy_coeffs(h, rsl->mb, pipe->coeffs + idx * coeffs_size, 0);
+
+        ff_h264_hl_decode_mb(h, rsl);
+    }
+
+    rsl->mb_y = row->mb_y;
+    if (row->lf_end > row->lf_start)
+        loop_filter(h, rsl, row->lf_start, row->lf_end);
+    if (row->finish)
+        decode_finish_row(h, rsl);
+
+    pthread_mutex_lock(&pipe->mutex);
+    pipe->busy = 0;
+    pipe->nb_reconstructed++;
+    pthread_cond_broadcast(&pipe->cond);
+}
+
+static void recon_save_mb(const H264Context *h, H264SliceContext *sl)
+{
+    H264ReconPipe *pipe   = sl->pipe;
+    const int slot        = pipe->nb_decoded % H264_RECON_ROWS;
+    const int idx         = slot * h->mb_width + sl->mb_x;
+    const int coeffs_size = 16 * 48 << h->pixel_shift;
+    H264ReconRow *row     = &pipe->rows[slot];
+    H264ReconMB *mb       = &pipe->mbs[idx];
+    const int mb_type     = h->cur_pic.mb_type[sl->mb_xy];
+
+    if (!pipe->row_started) {
+        /* first macroblock of the row, wait for the slot to be free */
+        pthread_mutex_lock(&pipe->mutex);
+        while (pipe->nb_decoded - pipe->nb_reconstructed >= H264_RECON_ROWS) {
+            if (!pipe->busy)
+                recon_next_row(h, pipe);
+            else
+                pthread_cond_wait(&pipe->cond, &pipe->mutex);
+        }
+        pthread_mutex_unlock(&pipe->mutex);
+
+        row->mb_y         = sl->mb_y;
+        row->start_x      = sl->mb_x;
+        pipe->row_started = 1;
+    }
+
+    mb->intra_pcm_ptr              = sl->intra_pcm_ptr;
+    mb->qscale                     = sl->qscale;
+    mb->chroma_qp[0]               = sl->chroma_qp[0];
+    mb->chroma_qp[1]               = sl->chroma_qp[1];
+    mb->cbp                        = sl->cbp;
+    mb->top_type                   = sl->top_type;
+    mb->chroma_pred_mode           = sl->chroma_pred_mode;
+    mb->intra16x16_pred_mode       = sl->intra16x16_pred_mode;
+    mb->topleft_samples_available  = sl->topleft_samples_available;
+    mb->topright_samples_available = sl->topright_samples_available;
+    memcpy(mb->intra4x4_pred_mode_cache, sl->intra4x4_pred_mode_cache,
+           sizeof(mb->intra4x4_pred_mode_cache));
+    memcpy(mb->non_zero_count_cache, sl->non_zero_count_cache,
+           sizeof(mb->non_zero_count_cache));
+    memcpy(mb->mv_cache,    sl->mv_cache,    sizeof(mb->mv_cache));
+    memcpy(mb->ref_cache,   sl->ref_cache,   sizeof(mb->ref_cache));
+    memcpy(mb->sub_mb_type, sl->sub_mb_type, sizeof(mb->sub_mb_type));
+    if (IS_INTRA16x16(mb_type))
+        memcpy(mb->mb_luma_dc, sl->mb_luma_dc, sizeof(mb->mb_luma_dc));
+
+    /* the entropy decoder expects the coefficients to be cleared */
+    mb->has_coeffs = sl->cbp || IS_INTRA16x16(mb_type);
+    if (mb->has_coeffs)
+        recon_copy_coeffs(h, pipe->coeffs + idx * coeffs_size, sl->mb, 1);
+
+    row->end_x = sl->mb_x + 1;
+}
+
+/* Make the macroblocks saved in the current row available for
+ * reconstruction, and deblock the given range after it. */
+static void recon_end_row(H264ReconPipe *pipe, int lf_start, int lf_end,
+                          int finish)
+{
+    H264ReconRow *row = &pipe->rows[pipe->nb_decoded % H264_RECON_ROWS];
+
+    if (!pipe->row_started)
+        return;
+
+    row->lf_start = lf_start;
+    row->lf_end   = lf_end;
+    row->finish   = finish;
+
+    pthread_mutex_lock(&pipe->mutex);
+    pipe->nb_decoded++;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->mutex);
+    pipe->row_started = 0;
+}
+
+#endif
+
+static void decode_mb_done(const H264Context *h, H264SliceContext *sl)
+{
+#if HAVE_THREADS
+    if (sl->pipe) {
+        recon_save_mb(h, sl);
+        return;
+    }
+#endif
+    ff_h264_hl_decode_mb(h, sl);
+}
+
+static void decode_filter_row(const H264Context *h, H264SliceContext *sl,
+                              int start_x, int end_x, int finish)
+{
+#if HAVE_THREADS
+    if (sl->pipe) {
+        recon_end_row(sl->pipe, start_x, end_x, finish);
+        sl->mb_x = end_x;
+        return;
+    }
+#endif
+
+    loop_filter(h, sl, start_x, end_x);
+    if (finish)
+        decode_finish_row(h, sl);
+}
+
 static int decode_slice(struct AVCodecContext *avctx, void *arg)
 {
     H264SliceContext *sl = arg;
@@ -2747,7 +2924,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             ret = ff_h264_decode_mb_cabac(h, sl);
 
             if (ret >= 0)
-                ff_h264_hl_decode_mb(h, sl);
+                decode_mb_done(h, sl);
 
             // FIXME optimal? or let mb_decode decode 16x32 ?
             if (ret >= 0 && FRAME_MBAFF(h)) {
@@ -2756,7 +2933,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 ret = ff_h264_decode_mb_cabac(h, sl);
 
                 if (ret >= 0)
-                    ff_h264_hl_decode_mb(h, sl);
+                    decode_mb_done(h, sl);
                 sl->mb_y--;
             }
             eos = get_cabac_terminate(&sl->cabac);
@@ -2766,7 +2943,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x >= lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x + 1);
+                    decode_filter_row(h, sl, lf_x_start, sl->mb_x + 1, 0);
                 goto finish;
             }
             if (sl->cabac.bytestream > sl->cabac.bytestream_end + 2 )
@@ -2776,15 +2953,17 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                        "error while decoding MB %d %d, bytestream %"PTRDIFF_SPECIFIER"\n",
                        sl->mb_x, sl->mb_y,
                        sl->cabac.bytestream_end - sl->cabac.bytestream);
+                /* drop the coefficients of the partially decoded macroblock,
+                 * the next slice expects them to be cleared */
+                memset(sl->mb, 0, sizeof(sl->mb));
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x,
                              sl->mb_y, ER_MB_ERROR);
                 return AVERROR_INVALIDDATA;
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                decode_filter_row(h, sl, lf_x_start, sl->mb_x, 1);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2799,7 +2978,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x - 1,
                              sl->mb_y, ER_MB_END);
                 if (sl->mb_x > lf_x_start)
-                    loop_filter(h, sl, lf_x_start, sl->mb_x);
+                    decode_filter_row(h, sl, lf_x_start, sl->mb_x, 0);
                 goto finish;
             }
         }
@@ -2818,7 +2997,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
             ret = ff_h264_decode_mb_cavlc(h, sl);
 
             if (ret >= 0)
-                ff_h264_hl_decode_mb(h, sl);
+                decode_mb_done(h, sl);
 
             // FIXME optimal? or let mb_decode decode 16x32 ?
             if (ret >= 0 && FRAME_MBAFF(h)) {
@@ -2826,22 +3005,22 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                 ret = ff_h264_decode_mb_cavlc(h, sl);
 
                 if (ret >= 0)
-                    ff_h264_hl_decode_mb(h, sl);
+                    decode_mb_done(h, sl);
                 sl->mb_y--;
             }
 
             if (ret < 0) {
                 av_log(h->avctx, AV_LOG_ERROR,
                        "error while decoding MB %d %d\n", sl->mb_x, sl->mb_y);
+                memset(sl->mb, 0, sizeof(sl->mb));
                 er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y, sl->mb_x,
                              sl->mb_y, ER_MB_ERROR);
                 return ret;
             }
 
             if (++sl->mb_x >= h->mb_width) {
-                loop_filter(h, sl, lf_x_start, sl->mb_x);
+                decode_filter_row(h, sl, lf_x_start, sl->mb_x, 1);
                 sl->mb_x = lf_x_start = 0;
-                decode_finish_row(h, sl);
                 ++sl->mb_y;
                 if (FIELD_OR_MBAFF_PICTURE(h)) {
                     ++sl->mb_y;
@@ -2875,7 +3054,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg)
                     er_add_slice(sl, sl->resync_mb_x, sl->resync_mb_y,
                                  sl->mb_x - 1, sl->mb_y, ER_MB_END);
                     if (sl->mb_x > lf_x_start)
-                        loop_filter(h, sl, lf_x_start, sl->mb_x);
+                        decode_filter_row(h, sl, lf_x_start, sl->mb_x, 0);
 
                     goto finish;
                 } else {
@@ -2893,6 +3072,133 @@ finish:
     return 0;
 }
 
+#if HAVE_THREADS
+/**
+ * Run as two jobs: the first one to start decodes the slice, and the other
+ * one reconstructs the decoded rows. The decoding job also reconstructs rows
+ * when it is too far ahead, so that neither job depends on the other one
+ * being scheduled to make progress.
+ */
+static int decode_slice_pipelined(struct AVCodecContext *avctx, void *arg)
+{
+    const H264Context *h = avctx->priv_data;
+    H264ReconPipe *pipe  = h->pipe;
+
+    if (!atomic_fetch_add(&pipe->nb_jobs, 1)) {
+        H264SliceContext *sl = &h->slice_ctx[0];
+        int ret = decode_slice(avctx, sl);
+
+        /* rows interrupted by an error are reconstructed but not deblocked */
+        recon_end_row(pipe, 0, 0, 0);
+
+        pthread_mutex_lock(&pipe->mutex);
+        pipe->ret          = ret;
+        pipe->entropy_done = 1;
+        pthread_cond_broadcast(&pipe->cond);
+        while (pipe->nb_reconstructed < pipe->nb_decoded) {
+            if (!pipe->busy)
+                recon_next_row(h, pipe);
+            else
+                pthread_cond_wait(&pipe->cond, &pipe->mutex);
+        }
+        pthread_mutex_unlock(&pipe->mutex);
+    } else {
+        pthread_mutex_lock(&pipe->mutex);
+        for (;;) {
+            if (!pipe->busy && pipe->nb_reconstructed < pipe->nb_decoded)
+                recon_next_row(h, pipe);
+            else if (pipe->entropy_done)
+                break;
+            else
+                pthread_cond_wait(&pipe->cond, &pipe->mutex);
+        }
+        pthread_mutex_unlock(&pipe->mutex);
+    }
+
+    return 0;
+}
+
+static int recon_pipeline_init(H264Context *h)
+{
+    H264SliceContext *sl  = &h->slice_ctx[0];
+    H264SliceContext *rsl = &h->slice_ctx[1];
+    H264ReconPipe *pipe   = h->pipe;
+    const size_t nb_mbs   = H264_RECON_ROWS * h->mb_width;
+    int ret;
+
+    if (!pipe) {
+        pipe = h->pipe = av_mallocz(sizeof(*pipe));
+        if (!pipe)
+            return AVERROR(ENOMEM);
+        pthread_mutex_init(&pipe->mutex, NULL);
+        pthread_cond_init(&pipe->cond, NULL);
+    }
+
+    av_fast_malloc(&pipe->mbs, &pipe->mbs_size, nb_mbs * sizeof(*pipe->mbs));
+    av_fast_malloc(&pipe->coeffs, &pipe->coeffs_size,
+                   nb_mbs * (16 * 48 * sizeof(*pipe->coeffs) << h->pixel_shift));
+    if (!pipe->mbs || !pipe->coeffs) {
+        av_freep(&pipe->mbs);
+        av_freep(&pipe->coeffs);
+        pipe->mbs_size = pipe->coeffs_size = 0;
+        return AVERROR(ENOMEM);
+    }
+
+    /* the reconstruction context gets the slice parameters, but keeps its
+     * own buffers */
+    {
+        uint8_t *bipred_scratchpad = rsl->bipred_scratchpad;
+        uint8_t *edge_emu_buffer   = rsl->edge_emu_buffer;
+        uint8_t (*top_borders0)[(16 * 3) * 2] = rsl->top_borders[0];
+        uint8_t (*top_borders1)[(16 * 3) * 2] = rsl->top_borders[1];
+        int bipred_scratchpad_allocated = rsl->bipred_scratchpad_allocated;
+        int edge_emu_buffer_allocated   = rsl->edge_emu_buffer_allocated;
+        int top_borders_allocated0      = rsl->top_borders_allocated[0];
+        int top_borders_allocated1      = rsl->top_borders_allocated[1];
+        int8_t *intra4x4_pred_mode      = rsl->intra4x4_pred_mode;
+        uint8_t (*mvd_table0)[2]        = rsl->mvd_table[0];
+        uint8_t (*mvd_table1)[2]        = rsl->mvd_table[1];
+        int16_t *dc_val_base            = rsl->dc_val_base;
+        ERContext er                    = rsl->er;
+
+        memcpy(rsl, sl, sizeof(*rsl));
+
+        rsl->bipred_scratchpad           = bipred_scratchpad;
+        rsl->edge_emu_buffer             = edge_emu_buffer;
+        rsl->top_borders[0]              = top_borders0;
+        rsl->top_borders[1]              = top_borders1;
+        rsl->bipred_scratchpad_allocated = bipred_scratchpad_allocated;
+        rsl->edge_emu_buffer_allocated   = edge_emu_buffer_allocated;
+        rsl->top_borders_allocated[0]    = top_borders_allocated0;
+        rsl->top_borders_allocated[1]    = top_borders_allocated1;
+        rsl->intra4x4_pred_mode          = intra4x4_pred_mode;
+        rsl->mvd_table[0]                = mvd_table0;
+        rsl->mvd_table[1]                = mvd_table1;
+        rsl->dc_val_base                 = dc_val_base;
+        rsl->er                          = er;
+    }
+
+    rsl->linesize   = h->cur_pic_ptr->f->linesize[0];
+    rsl->uvlinesize = h->cur_pic_ptr->f->linesize[1];
+    rsl->is_complex = h->picture_structure != PICT_FRAME ||
+                      (CONFIG_GRAY && (h->flags & AV_CODEC_FLAG_GRAY));
+    ret = alloc_scratch_buffers(rsl, rsl->linesize);
+    if (ret < 0)
+        return ret;
+
+    pipe->row_started      = 0;
+    pipe->nb_decoded       = 0;
+    pipe->nb_reconstructed = 0;
+    pipe->busy             = 0;
+    pipe->entropy_done     = 0;
+    pipe->ret              = 0;
+    atomic_init(&pipe->nb_jobs, 0);
+
+    sl->pipe = pipe;
+    return 0;
+}
+#endif
+
 /**
  * Call decode_slice() for each context.
  *
@@ -2918,6 +3224,16 @@ int ff_h264_execute_decode_slices(H264Context *h)
         h->slice_ctx[0].next_slice_idx = h->mb_width * h->mb_height;
         h->postpone_filter = 0;
 
+#if HAVE_THREADS
+        if (h->recon_pipeline && h->nb_slice_ctx > 1 && !FRAME_MBAFF(h) &&
+            (avctx->active_thread_type & FF_THREAD_SLICE) &&
+            recon_pipeline_init(h) >= 0) {
+            avctx->execute(avctx, decode_slice_pipelined, h->slice_ctx,
+                           NULL, 2, sizeof(h->slice_ctx[0]));
+            h->slice_ctx[0].pipe = NULL;
+            ret = h->pipe->ret;
+        } else
+#endif
         ret = decode_slice(avctx, &h->slice_ctx[0]);
         h->mb_y = h->slice_ctx[0].mb_y;
         if (ret < 0)
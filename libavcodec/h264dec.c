@@ -355,6 +355,16 @@ static av_cold int h264_decode_end(AVCodecContext *avctx)
     av_freep(&h->slice_ctx);
     h->nb_slice_ctx = 0;
 
+#if HAVE_THREADS
+    if (h->pipe) {
+        pthread_mutex_destroy(&h->pipe->mutex);
+        pthread_cond_destroy(&h->pipe->cond);
+        av_freep(&h->pipe->mbs);
+        av_freep(&h->pipe->coeffs);
+        av_freep(&h->pipe);
+    }
+#endif
+
     ff_h264_sei_uninit(&h->sei);
     ff_h264_ps_uninit(&h->ps);
 
@@ -1056,6 +1066,7 @@ static const AVOption h264_options[] = {
     { "nal_length_size", "nal_length_size", OFFSET(nal_length_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 4, VDX },
     { "enable_er", "Enable error resilience on damaged frames (unsafe)", OFFSET(enable_er), AV_OPT_TYPE_BOOL, { .i64 = -1 }, -1, 1, VD },
     { "x264_build", "Assume this x264 version if no x264 version found in any SEI", OFFSET(x264_build), AV_OPT_TYPE_INT, {.i64 = -1}, -1, INT_MAX, VD },
+    { "recon_pipeline", "Reconstruct single slice pictures on another slice thread while they are entropy decoded", OFFSET(recon_pipeline), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VD },
     { NULL },
 };
 
@@ -28,9 +28,12 @@
 #ifndef AVCODEC_H264DEC_H
 #define AVCODEC_H264DEC_H
 
+#include <stdatomic.h>
+
 #include "libavutil/buffer.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/thread.h"
 
 #include "cabac.h"
 #include "error_resilience.h"
@@ -167,6 +170,68 @@ typedef struct H264Ref {
     H264Picture *parent;
 } H264Ref;
 
+/**
+ * Number of macroblock rows that the entropy decoder can be ahead of the
+ * reconstruction when they are pipelined.
+ */
+#define H264_RECON_ROWS 4
+
+/**
+ * Decoded state of a macroblock, needed to reconstruct it.
+ */
+typedef struct H264ReconMB {
+    const uint8_t *intra_pcm_ptr;
+    int qscale;
+    int chroma_qp[2];
+    int cbp;
+    int top_type;
+    int chroma_pred_mode;
+    int intra16x16_pred_mode;
+    unsigned int topleft_samples_available;
+    unsigned int topright_samples_available;
+    int has_coeffs;             ///< the coefficients were saved
+    int8_t intra4x4_pred_mode_cache[5 * 8];
+    DECLARE_ALIGNED(8,  uint8_t, non_zero_count_cache)[15 * 8];
+    DECLARE_ALIGNED(16, int16_t, mv_cache)[2][5 * 8][2];
+    DECLARE_ALIGNED(8,  int8_t, ref_cache)[2][5 * 8];
+    DECLARE_ALIGNED(8,  uint16_t, sub_mb_type)[4];
+    DECLARE_ALIGNED(16, int16_t, mb_luma_dc)[3][16 * 2];
+} H264ReconMB;
+
+typedef struct H264ReconRow {
+    int mb_y;
+    int start_x, end_x;         ///< macroblocks to reconstruct
+    int lf_start, lf_end;       ///< macroblocks to deblock
+    int finish;                 ///< draw the band and report progress
+} H264ReconRow;
+
+/**
+ * State of the pipeline between the entropy decoding and the reconstruction
+ * of single slice pictures with slice threading. The entropy decoder saves
+ * the state of each macroblock, and the reconstruction and deblocking of
+ * complete rows run on another thread meanwhile.
+ */
+typedef struct H264ReconPipe {
+#if HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+#endif
+
+    H264ReconRow rows[H264_RECON_ROWS];
+    H264ReconMB *mbs;           ///< H264_RECON_ROWS rows of mb_width macroblocks
+    int16_t *coeffs;            ///< coefficients of mbs, 16 * 48 dctcoef each
+    unsigned int mbs_size;
+    unsigned int coeffs_size;
+
+    int row_started;            ///< the entropy decoder is filling a row
+    int nb_decoded;             ///< rows made available by the entropy decoder
+    int nb_reconstructed;       ///< rows reconstructed and deblocked
+    int busy;                   ///< a row is being reconstructed
+    int entropy_done;
+    atomic_int nb_jobs;
+    int ret;
+} H264ReconPipe;
+
 typedef struct H264SliceContext {
     struct H264Context *h264;
     GetBitContext gb;
@@ -323,6 +388,12 @@ typedef struct H264SliceContext {
     int delta_poc[2];
     int curr_pic_num;
     int max_pic_num;
+
+    /**
+     * Reconstruction pipeline, set when the reconstruction of the
+     * macroblocks decoded in this context is done on another thread.
+     */
+    H264ReconPipe *pipe;
 } H264SliceContext;
 
 /**
@@ -543,6 +614,8 @@ typedef struct H264Context {
     int height_from_caller;
 
     int enable_er;
+    int recon_pipeline;
+    H264ReconPipe *pipe;
 
     H264SEIContext sei;
 
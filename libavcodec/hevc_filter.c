@@ -141,17 +141,23 @@ static void copy_CTB(uint8_t *dst, const uint8_t *src, int width, int height,
 {
     int i, j;
 
+    /* do not read past width, the next pixels may belong to a CTB that
+     * another WPP row is filtering */
     if (((intptr_t)dst | (intptr_t)src | stride_dst | stride_src) & 15) {
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j+=8)
+            for (j = 0; j < width - 7; j+=8)
                 AV_COPY64U(dst+j, src+j);
+            if (j < width)
+                memcpy(dst + j, src + j, width - j);
             dst += stride_dst;
             src += stride_src;
         }
     } else {
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j+=16)
+            for (j = 0; j < width - 15; j+=16)
                 AV_COPY128(dst+j, src+j);
+            if (j < width)
+                memcpy(dst + j, src + j, width - j);
             dst += stride_dst;
             src += stride_src;
         }
@@ -861,15 +867,15 @@ void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size)
             sao_filter_CTB(s, x - ctb_size, y);
         if (y && x_end) {
             sao_filter_CTB(s, x, y - ctb_size);
-            if (s->threads_type & FF_THREAD_FRAME )
+            if (s->threads_type & FF_THREAD_FRAME && !s->wpp_frame_progress)
                 ff_thread_report_progress(&s->ref->tf, y, 0);
         }
         if (x_end && y_end) {
             sao_filter_CTB(s, x , y);
-            if (s->threads_type & FF_THREAD_FRAME )
+            if (s->threads_type & FF_THREAD_FRAME && !s->wpp_frame_progress)
                 ff_thread_report_progress(&s->ref->tf, y + ctb_size, 0);
         }
-    } else if (s->threads_type & FF_THREAD_FRAME && x_end)
+    } else if (s->threads_type & FF_THREAD_FRAME && !s->wpp_frame_progress && x_end)
         ff_thread_report_progress(&s->ref->tf, y + ctb_size - 4, 0);
 }
 
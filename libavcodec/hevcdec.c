@@ -2538,6 +2538,34 @@ static int hls_slice_data(HEVCContext *s)
     s->avctx->execute(s->avctx, hls_decode_entry, arg, ret , 1, sizeof(int));
     return ret[0];
 }
+static void wpp_report_progress(HEVCContext *s1, int ctb_row, int thread, int n)
+{
+    if (!s1->wpp_thread) {
+        ff_thread_report_progress2(s1->avctx, ctb_row, thread, n);
+        return;
+    }
+
+    pthread_mutex_lock(&s1->wpp_progress_mutex);
+    s1->wpp_entries[ctb_row] += n;
+    pthread_cond_broadcast(&s1->wpp_progress_cond);
+    pthread_mutex_unlock(&s1->wpp_progress_mutex);
+}
+
+static void wpp_await_progress(HEVCContext *s1, int ctb_row, int thread, int shift)
+{
+    if (!s1->wpp_thread) {
+        ff_thread_await_progress2(s1->avctx, ctb_row, thread, shift);
+        return;
+    }
+    if (!ctb_row)
+        return;
+
+    pthread_mutex_lock(&s1->wpp_progress_mutex);
+    while (s1->wpp_entries[ctb_row - 1] - s1->wpp_entries[ctb_row] < shift)
+        pthread_cond_wait(&s1->wpp_progress_cond, &s1->wpp_progress_mutex);
+    pthread_mutex_unlock(&s1->wpp_progress_mutex);
+}
+
 static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int job, int self_id)
 {
     HEVCContext *s1  = avctxt->priv_data, *s;
@@ -2567,10 +2595,10 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
 
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
-        ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
+        wpp_await_progress(s1, ctb_row, thread, SHIFT_CTB_WPP);
 
         if (atomic_load(&s1->wpp_err)) {
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row , thread, SHIFT_CTB_WPP);
             return 0;
         }
 
@@ -2578,6 +2606,11 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         if (ret < 0)
             goto error;
         hls_sao_param(s, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
         more_data = hls_coding_quadtree(s, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
 
         if (more_data < 0) {
@@ -2588,18 +2621,20 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         ctb_addr_ts++;
 
         ff_hevc_save_states(s, ctb_addr_ts);
-        ff_thread_report_progress2(s->avctx, ctb_row, thread, 1);
+        /* the next row applies SAO next to the CTBs filtered here, so it
+         * may only continue once they are done */
         ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+        wpp_report_progress(s1, ctb_row, thread, 1);
 
         if (!more_data && (x_ctb+ctb_size) < s->ps.sps->width && ctb_row != s->sh.num_entry_point_offsets) {
             atomic_store(&s1->wpp_err, 1);
-            ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row ,thread, SHIFT_CTB_WPP);
             return 0;
         }
 
         if ((x_ctb+ctb_size) >= s->ps.sps->width && (y_ctb+ctb_size) >= s->ps.sps->height ) {
             ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s1, ctb_row , thread, SHIFT_CTB_WPP);
             return ctb_addr_ts;
         }
         ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
@@ -2609,16 +2644,78 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
             break;
         }
     }
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s1, ctb_row ,thread, SHIFT_CTB_WPP);
 
     return 0;
 error:
     s->tab_slice_address[ctb_addr_rs] = -1;
     atomic_store(&s1->wpp_err, 1);
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s1, ctb_row ,thread, SHIFT_CTB_WPP);
     return ret;
 }
 
+/*
+ * Called when a row of a WPP slice has been decoded by a frame thread with
+ * WPP row threads. Rows may finish out of order, so the progress of the
+ * frame is only advanced over the rows that are complete along with all
+ * the rows above them. The values match what ff_hevc_hls_filter() reports
+ * without WPP row threads.
+ */
+static void wpp_row_done(HEVCContext *s, int ctb_row)
+{
+    const HEVCSPS *sps = s->ps.sps;
+    int first_row = s->sh.slice_ctb_addr_rs / sps->ctb_width;
+
+    pthread_mutex_lock(&s->wpp_progress_mutex);
+    s->wpp_row_done[ctb_row] = 1;
+    if (s->wpp_row_done[s->wpp_rows_reported]) {
+        int last_row, progress;
+
+        while (s->wpp_rows_reported < s->nb_wpp_rows &&
+               s->wpp_row_done[s->wpp_rows_reported])
+            s->wpp_rows_reported++;
+        last_row = first_row + s->wpp_rows_reported - 1;
+
+        /* decoding a row deblocks the row above it and applies SAO to the
+         * row above that one, the last row of the picture is fully filtered */
+        if (last_row >= sps->ctb_height - 1)
+            progress = sps->height;
+        else if (sps->sao_enabled)
+            progress = last_row ? (last_row - 1) << sps->log2_ctb_size : 0;
+        else
+            progress = (last_row << sps->log2_ctb_size) - 4;
+        if (progress > 0)
+            ff_thread_report_progress(&s->ref->tf, progress, 0);
+    }
+    pthread_mutex_unlock(&s->wpp_progress_mutex);
+}
+
+static void wpp_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+
+    s->wpp_ret[jobnr] = hls_decode_entry_wpp(s->avctx, s->wpp_arg, jobnr, threadnr);
+    wpp_row_done(s, jobnr);
+}
+
+static int wpp_alloc_entries(HEVCContext *s, int count)
+{
+    if (count > s->nb_wpp_rows) {
+        av_freep(&s->wpp_entries);
+        av_freep(&s->wpp_row_done);
+        s->nb_wpp_rows = 0;
+        s->wpp_entries  = av_calloc(count, sizeof(*s->wpp_entries));
+        s->wpp_row_done = av_calloc(count, sizeof(*s->wpp_row_done));
+        if (!s->wpp_entries || !s->wpp_row_done)
+            return AVERROR(ENOMEM);
+    }
+    s->nb_wpp_rows = count;
+    memset(s->wpp_entries,  0, count * sizeof(*s->wpp_entries));
+    memset(s->wpp_row_done, 0, count * sizeof(*s->wpp_row_done));
+    s->wpp_rows_reported = 0;
+    return 0;
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2645,7 +2742,12 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         goto error;
     }
 
-    ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+    if (s->wpp_thread)
+        res = wpp_alloc_entries(s, s->sh.num_entry_point_offsets + 1);
+    else
+        res = ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+    if (res < 0)
+        goto error;
 
     for (i = 1; i < s->threads_number; i++) {
         if (s->sList[i] && s->HEVClcList[i])
@@ -2696,6 +2798,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 
     }
     s->data = data;
+    s->wpp_frame_progress = !!s->wpp_thread;
 
     for (i = 1; i < s->threads_number; i++) {
         s->sList[i]->HEVClc->first_qp_group = 1;
@@ -2705,15 +2808,23 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     atomic_store(&s->wpp_err, 0);
-    ff_reset_entries(s->avctx);
+    if (!s->wpp_thread)
+        ff_reset_entries(s->avctx);
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
         arg[i] = i;
         ret[i] = 0;
     }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        if (s->wpp_thread) {
+            s->wpp_arg = arg;
+            s->wpp_ret = ret;
+            avpriv_slicethread_execute(s->wpp_thread, s->sh.num_entry_point_offsets + 1, 0);
+        } else
+            s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
+    }
+    s->wpp_frame_progress = 0;
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -3626,6 +3737,14 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     av_freep(&s->HEVClcList);
     av_freep(&s->sList);
 
+    if (s->wpp_thread) {
+        avpriv_slicethread_free(&s->wpp_thread);
+        pthread_cond_destroy(&s->wpp_progress_cond);
+        pthread_mutex_destroy(&s->wpp_progress_mutex);
+    }
+    av_freep(&s->wpp_entries);
+    av_freep(&s->wpp_row_done);
+
     ff_h2645_packet_uninit(&s->pkt);
 
     ff_hevc_reset_sei(&s->sei);
@@ -3821,6 +3940,17 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
     else
         s->threads_type = FF_THREAD_SLICE;
 
+    if (s->threads_type == FF_THREAD_FRAME && s->wpp_threads > 1) {
+        ret = avpriv_slicethread_create(&s->wpp_thread, s, wpp_worker, NULL, s->wpp_threads);
+        if (ret > 1) {
+            pthread_mutex_init(&s->wpp_progress_mutex, NULL);
+            pthread_cond_init(&s->wpp_progress_cond, NULL);
+            avpriv_slicethread_set_priority(s->wpp_thread, AVPRIV_SLICETHREAD_PRIORITY_CODEC);
+            s->threads_number = ret;
+        } else
+            avpriv_slicethread_free(&s->wpp_thread);
+    }
+
     ret = hevc_init_context(avctx);
     if (ret < 0)
         return ret;
@@ -3862,6 +3992,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "Number of threads decoding the CTB rows of WPP streams in parallel inside each frame thread", OFFSET(wpp_threads),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, PAR },
     { NULL },
 };
 
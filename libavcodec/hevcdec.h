@@ -27,6 +27,8 @@
 
 #include "libavutil/buffer.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avcodec.h"
 #include "bswapdsp.h"
@@ -557,6 +559,28 @@ typedef struct HEVCContext {
     int enable_parallel_tiles;
     atomic_int wpp_err;
 
+    /**
+     * WPP row threads used inside each frame thread (see the wpp_threads
+     * option). Row progress is tracked here instead of by the slice
+     * threading code, which is not active together with frame threading.
+     */
+    int wpp_threads;
+    AVSliceThread *wpp_thread;
+    pthread_mutex_t wpp_progress_mutex;
+    pthread_cond_t  wpp_progress_cond;
+    int *wpp_entries;           ///< number of decoded CTBs per row of the slice
+    uint8_t *wpp_row_done;
+    int nb_wpp_rows;
+    int wpp_rows_reported;      ///< rows whose frame thread progress was reported
+    int *wpp_arg;
+    int *wpp_ret;
+    /**
+     * Set while the WPP rows of a frame-threaded decoder run in parallel;
+     * frame thread progress is then reported per completed row instead
+     * of by the loop filter.
+     */
+    uint8_t wpp_frame_progress;
+
     const uint8_t *data;
 
     H2645Packet pkt;
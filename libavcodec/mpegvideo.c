@@ -344,7 +344,7 @@ av_cold void ff_mpv_idct_init(MpegEncContext *s)
     ff_init_scantable(s->idsp.idct_permutation, &s->intra_v_scantable, ff_alternate_vertical_scan);
 }
 
-static int init_duplicate_context(MpegEncContext *s)
+int ff_mpv_init_duplicate_context(MpegEncContext *s)
 {
     int y_size = s->b8_stride * (2 * s->mb_height + 1);
     int c_size = s->mb_stride * (s->mb_height + 1);
@@ -394,13 +394,13 @@ int ff_mpv_init_duplicate_contexts(MpegEncContext *s)
     int nb_slices = s->slice_context_count, ret;
 
     /* We initialize the copies before the original so that
-     * fields allocated in init_duplicate_context are NULL after
+     * fields allocated in ff_mpv_init_duplicate_context() are NULL after
      * copying. This prevents double-frees upon allocation error. */
     for (int i = 1; i < nb_slices; i++) {
         s->thread_context[i] = av_memdup(s, sizeof(MpegEncContext));
         if (!s->thread_context[i])
             return AVERROR(ENOMEM);
-        if ((ret = init_duplicate_context(s->thread_context[i])) < 0)
+        if ((ret = ff_mpv_init_duplicate_context(s->thread_context[i])) < 0)
             return ret;
         s->thread_context[i]->start_mb_y =
             (s->mb_height * (i    ) + nb_slices / 2) / nb_slices;
@@ -410,10 +410,10 @@ int ff_mpv_init_duplicate_contexts(MpegEncContext *s)
     s->start_mb_y = 0;
     s->end_mb_y   = nb_slices > 1 ? (s->mb_height + nb_slices / 2) / nb_slices
                                   : s->mb_height;
-    return init_duplicate_context(s);
+    return ff_mpv_init_duplicate_context(s);
 }
 
-static void free_duplicate_context(MpegEncContext *s)
+void ff_mpv_free_duplicate_context(MpegEncContext *s)
 {
     if (!s)
         return;
@@ -436,10 +436,10 @@ static void free_duplicate_context(MpegEncContext *s)
 static void free_duplicate_contexts(MpegEncContext *s)
 {
     for (int i = 1; i < s->slice_context_count; i++) {
-        free_duplicate_context(s->thread_context[i]);
+        ff_mpv_free_duplicate_context(s->thread_context[i]);
         av_freep(&s->thread_context[i]);
     }
-    free_duplicate_context(s);
+    ff_mpv_free_duplicate_context(s);
 }
 
 static void backup_duplicate_context(MpegEncContext *bak, MpegEncContext *src)
@@ -742,6 +742,8 @@ av_cold int ff_mpv_common_init(MpegEncContext *s)
 
     if (s->encoding && s->avctx->slices)
         nb_slices = s->avctx->slices;
+    else if (s->encoding && s->me_lookahead)
+        nb_slices = 1; /* the threads are used for the lookahead instead */
 
     if (s->codec_id == AV_CODEC_ID_MPEG2VIDEO && !s->progressive_sequence)
         s->mb_height = (s->height + 31) / 32 * 2;
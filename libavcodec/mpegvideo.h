@@ -241,6 +241,8 @@ typedef struct MpegEncContext {
     int motion_est;                      ///< ME algorithm
     int me_penalty_compensation;
     int me_pre;                          ///< prepass for motion estimation
+    int me_lookahead;                    ///< estimate motion of the next B-frame while encoding
+    struct MPVLookahead *lookahead;      ///< me_lookahead state, private to mpegvideo_enc.c
     int mv_dir;
 #define MV_DIR_FORWARD   1
 #define MV_DIR_BACKWARD  2
@@ -566,9 +568,19 @@ void ff_mpv_common_init_mips(MpegEncContext *s);
 /**
  * Initialize an MpegEncContext's thread contexts. Presumes that
  * slice_context_count is already set and that all the fields
- * that are freed/reset in free_duplicate_context() are NULL.
+ * that are freed/reset in ff_mpv_free_duplicate_context() are NULL.
  */
 int ff_mpv_init_duplicate_contexts(MpegEncContext *s);
+/**
+ * Allocate the per-thread buffers of a single context copied from
+ * the main one, whose buffers must be NULL.
+ */
+int ff_mpv_init_duplicate_context(MpegEncContext *s);
+/**
+ * Free the buffers allocated by ff_mpv_init_duplicate_context() and
+ * ff_update_duplicate_context().
+ */
+void ff_mpv_free_duplicate_context(MpegEncContext *s);
 /**
  * Initialize and allocates MpegEncContext fields dependent on the resolution.
  */
@@ -266,6 +266,126 @@ static void update_duplicate_context_after_me(MpegEncContext *dst,
 #undef COPY
 }
 
+/**
+ * State for estimating the motion of the next coded picture while the
+ * current one is being encoded (me_lookahead).
+ *
+ * The next picture is only known in advance when it is a queued B-frame,
+ * whose references are the ones of the current picture. Its motion
+ * estimation runs on a duplicate context with its own result tables and
+ * follows the encoding of the current picture row by row, as it reads the
+ * P MV table cleared for intra MBs and, if the current picture is the
+ * backward reference, its reconstructed pixels.
+ */
+typedef struct MPVLookahead {
+    MpegEncContext *ctx;        ///< duplicate context doing the estimation
+    AVFrame *src;               ///< source of the estimated picture
+    Picture *pic;               ///< estimated picture
+    uint8_t *src_data;          ///< luma data pointer the estimation used
+    int running;                ///< estimation is running concurrently
+    int valid;                  ///< tables hold the result for pic
+    int lag;                    ///< rows to wait for per estimated row
+
+    int mb_array_size;
+    int mv_table_size;
+    uint16_t *mb_type;
+    uint16_t *mc_mb_var;
+    int16_t (*mv_table_base)[2];        ///< forw, back, bidir forw, bidir back, direct
+    int16_t (*field_mv_table_base)[2];
+    uint8_t *field_select_table;
+
+#if HAVE_THREADS
+    pthread_mutex_t progress_mutex;
+    pthread_cond_t  progress_cond;
+#endif
+    int rows_done;              ///< MB rows of the current picture encoded
+} MPVLookahead;
+
+static av_cold int lookahead_init(MpegEncContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    MPVLookahead *la;
+
+    if (!HAVE_THREADS || !s->max_b_frames || s->slice_context_count > 1 ||
+        !(avctx->active_thread_type & FF_THREAD_SLICE) ||
+        avctx->thread_count < 2 || avctx->flags & AV_CODEC_FLAG_PASS2 ||
+        s->noise_reduction) {
+        av_log(avctx, AV_LOG_VERBOSE,
+               "Motion estimation lookahead not used: it requires B-frames, "
+               "a single slice, slice threading and no 2-pass or noise reduction.\n");
+        return 0;
+    }
+
+    la = av_mallocz(sizeof(*la));
+    if (!la)
+        return AVERROR(ENOMEM);
+    s->lookahead = la;
+
+#if HAVE_THREADS
+    pthread_mutex_init(&la->progress_mutex, NULL);
+    pthread_cond_init(&la->progress_cond, NULL);
+#endif
+
+    la->mb_array_size = s->mb_height * s->mb_stride;
+    la->mv_table_size = (s->mb_height + 2) * s->mb_stride + 1;
+    la->src = av_frame_alloc();
+    if (!la->src ||
+        !FF_ALLOCZ_TYPED_ARRAY(la->mb_type,       la->mb_array_size) ||
+        !FF_ALLOCZ_TYPED_ARRAY(la->mc_mb_var,     la->mb_array_size) ||
+        !FF_ALLOCZ_TYPED_ARRAY(la->mv_table_base, 5 * la->mv_table_size))
+        return AVERROR(ENOMEM);
+    if (s->b_field_mv_table_base) {
+        if (!FF_ALLOCZ_TYPED_ARRAY(la->field_mv_table_base, 8 * la->mv_table_size) ||
+            !FF_ALLOCZ_TYPED_ARRAY(la->field_select_table,  8 * la->mv_table_size))
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static av_cold void lookahead_free(MpegEncContext *s)
+{
+    MPVLookahead *la = s->lookahead;
+
+    if (!la)
+        return;
+
+    if (la->ctx) {
+        ff_mpv_free_duplicate_context(la->ctx);
+        av_freep(&la->ctx);
+    }
+    av_frame_free(&la->src);
+    av_freep(&la->mb_type);
+    av_freep(&la->mc_mb_var);
+    av_freep(&la->mv_table_base);
+    av_freep(&la->field_mv_table_base);
+    av_freep(&la->field_select_table);
+#if HAVE_THREADS
+    pthread_mutex_destroy(&la->progress_mutex);
+    pthread_cond_destroy(&la->progress_cond);
+#endif
+    av_freep(&s->lookahead);
+}
+
+static void lookahead_report_rows(MPVLookahead *la, int rows)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&la->progress_mutex);
+    la->rows_done = rows;
+    pthread_cond_broadcast(&la->progress_cond);
+    pthread_mutex_unlock(&la->progress_mutex);
+#endif
+}
+
+static void lookahead_await_rows(MPVLookahead *la, int rows)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&la->progress_mutex);
+    while (la->rows_done < rows)
+        pthread_cond_wait(&la->progress_cond, &la->progress_mutex);
+    pthread_mutex_unlock(&la->progress_mutex);
+#endif
+}
+
 static void mpv_encode_init_static(void)
 {
    for (int i = -16; i < 16; i++)
@@ -843,6 +963,9 @@ av_cold int ff_mpv_encode_init(AVCodecContext *avctx)
             s->h263_slice_structured = 1;
     }
 
+    if (s->me_lookahead && (ret = lookahead_init(s)) < 0)
+        return ret;
+
     s->quant_precision = 5;
 
     ff_set_cmp(&s->mecc, s->mecc.ildct_cmp,      avctx->ildct_cmp);
@@ -932,6 +1055,7 @@ av_cold int ff_mpv_encode_end(AVCodecContext *avctx)
 
     ff_rate_control_uninit(s);
 
+    lookahead_free(s);
     ff_mpv_common_end(s);
 
     for (i = 0; i < FF_ARRAY_ELEMS(s->tmp_frames); i++)
@@ -3369,6 +3493,8 @@ static int encode_thread(AVCodecContext *c, void *arg){
             ff_dlog(s->avctx, "MB %d %d bits\n",
                     s->mb_x + s->mb_y * s->mb_stride, put_bits_count(&s->pb));
         }
+        if (s->lookahead && s->lookahead->running)
+            lookahead_report_rows(s->lookahead, mb_y_order + 1);
     }
 
     //not beautiful here but we must write it before flushing so it has to be here
@@ -3467,6 +3593,217 @@ static void set_frame_distances(MpegEncContext * s){
     }
 }
 
+static void lookahead_copy_tables(MpegEncContext *s, MPVLookahead *la, int to_la)
+{
+    int16_t (*const mv_tables[5])[2] = {
+        s->b_forw_mv_table_base,       s->b_back_mv_table_base,
+        s->b_bidir_forw_mv_table_base, s->b_bidir_back_mv_table_base,
+        s->b_direct_mv_table_base,
+    };
+    size_t mv_size = la->mv_table_size * sizeof(*la->mv_table_base);
+
+#define COPY_TABLE(dst, src, size) memcpy(to_la ? (dst) : (src), to_la ? (src) : (dst), size)
+    for (int i = 0; i < 5; i++)
+        COPY_TABLE(la->mv_table_base + i * la->mv_table_size, mv_tables[i], mv_size);
+    if (la->field_mv_table_base) {
+        COPY_TABLE(la->field_mv_table_base, s->b_field_mv_table_base, 8 * mv_size);
+        COPY_TABLE(la->field_select_table,  s->b_field_select_table[0][0],
+                   8 * la->mv_table_size);
+    }
+    COPY_TABLE(la->mb_type, s->mb_type, la->mb_array_size * sizeof(*la->mb_type));
+#undef COPY_TABLE
+}
+
+/**
+ * Start estimating the motion of the next coded picture, to be run
+ * concurrently with encode_thread() on the current one.
+ *
+ * @return 1 if the estimation was set up, 0 if it cannot be done ahead,
+ *         a negative error code on failure
+ */
+static int lookahead_start(MpegEncContext *s)
+{
+    MPVLookahead *la = s->lookahead;
+    Picture *next;
+    MpegEncContext *ctx;
+    int ret;
+
+    if (!la)
+        return 0;
+    la->valid = 0;
+
+    next = s->reordered_input_picture[1];
+    if (!next || next->f->pict_type != AV_PICTURE_TYPE_B || !next->f->data[0])
+        return 0;
+
+    /* the temporal predictors read the P MV table up to last_predictor_count
+     * rows below, and encode_thread() clears it for intra MBs */
+    la->lag = 2 + FFMAX(s->avctx->last_predictor_count, 0);
+    if (s->pict_type != AV_PICTURE_TYPE_B) {
+        int range = s->avctx->me_range >> 1;
+
+        /* the current picture is the backward reference, the search window
+         * must be bounded and must not reach into the edges drawn at the
+         * end of the picture; allow for subpel and field interpolation */
+        if (s->out_format != FMT_MPEG1 || s->unrestricted_mv || range <= 0)
+            return 0;
+        la->lag = FFMAX(la->lag, 1 + ((range + 4 + 15) >> 4));
+    }
+
+    if (!la->ctx) {
+        la->ctx = av_mallocz(sizeof(*la->ctx));
+        if (!la->ctx)
+            return AVERROR(ENOMEM);
+        if ((ret = ff_update_duplicate_context(la->ctx, s)) < 0 ||
+            (ret = ff_mpv_init_duplicate_context(la->ctx)) < 0)
+            return ret;
+        la->ctx->start_mb_y = 0;
+        la->ctx->end_mb_y   = s->mb_height;
+    }
+    ctx = la->ctx;
+    if ((ret = ff_update_duplicate_context(ctx, s)) < 0)
+        return ret;
+
+    av_frame_unref(la->src);
+    if ((ret = av_frame_ref(la->src, next->f)) < 0)
+        return ret;
+    /* same as select_input_picture() will do */
+    if (!next->shared && !s->avctx->rc_buffer_size) {
+        for (int i = 0; i < 4; i++)
+            if (la->src->data[i])
+                la->src->data[i] += INPLACE_OFFSET;
+    }
+
+    lookahead_copy_tables(s, la, 1);
+    ctx->mb_type               = la->mb_type;
+    ctx->b_forw_mv_table       = la->mv_table_base + 0 * la->mv_table_size + s->mb_stride + 1;
+    ctx->b_back_mv_table       = la->mv_table_base + 1 * la->mv_table_size + s->mb_stride + 1;
+    ctx->b_bidir_forw_mv_table = la->mv_table_base + 2 * la->mv_table_size + s->mb_stride + 1;
+    ctx->b_bidir_back_mv_table = la->mv_table_base + 3 * la->mv_table_size + s->mb_stride + 1;
+    ctx->b_direct_mv_table     = la->mv_table_base + 4 * la->mv_table_size + s->mb_stride + 1;
+    if (la->field_mv_table_base) {
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                for (int k = 0; k < 2; k++)
+                    ctx->b_field_mv_table[i][j][k] = la->field_mv_table_base +
+                        (s->b_field_mv_table[i][j][k] - s->b_field_mv_table_base);
+                ctx->b_field_select_table[i][j] = la->field_select_table +
+                    (s->b_field_select_table[i][j] - s->b_field_select_table[0][0]);
+            }
+        }
+    }
+
+    /* mirror what encode_picture() will do for the next picture */
+    ctx->new_picture.f             = la->src;
+    ctx->current_picture_ptr       = next;
+    ctx->current_picture.mc_mb_var = la->mc_mb_var;
+    ctx->pict_type                 = AV_PICTURE_TYPE_B;
+    ctx->picture_number            = next->f->display_picture_number;
+    ctx->mb_intra                  = 0;
+    if (s->out_format == FMT_MPEG1 || (s->h263_pred && !s->msmpeg4_version))
+        set_frame_distances(ctx);
+    if (CONFIG_MPEG4_ENCODER && s->codec_id == AV_CODEC_ID_MPEG4)
+        ff_set_mpeg4_time(ctx);
+
+    if (!(s->avctx->flags & AV_CODEC_FLAG_QSCALE)) {
+        ctx->lambda = s->pict_type == AV_PICTURE_TYPE_B ?
+                      s->current_picture_ptr->f->quality :
+                      s->last_lambda_for[AV_PICTURE_TYPE_B];
+        update_qscale(ctx);
+    }
+    if (ff_init_me(ctx) < 0)
+        return 0;
+    ctx->lambda  = (ctx->lambda  * s->me_penalty_compensation + 128) >> 8;
+    ctx->lambda2 = (ctx->lambda2 * (int64_t) s->me_penalty_compensation + 128) >> 8;
+    ctx->me.scene_change_score = 0;
+    ctx->me.mb_var_sum_temp    =
+    ctx->me.mc_mb_var_sum_temp = 0;
+
+    la->pic       = next;
+    la->src_data  = la->src->data[0];
+    la->rows_done = 0;
+    la->running   = 1;
+    return 1;
+}
+
+static int lookahead_thread(AVCodecContext *c, void *arg, int jobnr, int threadnr)
+{
+    MpegEncContext *s = arg;
+    MPVLookahead *la = s->lookahead;
+    MpegEncContext *ctx = la->ctx;
+
+    if (!jobnr) {
+        int ret = encode_thread(c, &s);
+        lookahead_report_rows(la, INT_MAX);
+        return ret;
+    }
+
+    ctx->me.dia_size = c->dia_size;
+    ctx->first_slice_line = 1;
+    for (ctx->mb_y = 0; ctx->mb_y < ctx->mb_height; ctx->mb_y++) {
+        lookahead_await_rows(la, FFMIN(ctx->mb_y + la->lag, ctx->mb_height));
+        ctx->mb_x = 0;
+        ff_init_block_index(ctx);
+        for (ctx->mb_x = 0; ctx->mb_x < ctx->mb_width; ctx->mb_x++) {
+            ctx->block_index[0] += 2;
+            ctx->block_index[1] += 2;
+            ctx->block_index[2] += 2;
+            ctx->block_index[3] += 2;
+            ff_estimate_b_frame_motion(ctx, ctx->mb_x, ctx->mb_y);
+        }
+        ctx->first_slice_line = 0;
+    }
+    return 0;
+}
+
+static void lookahead_end(MpegEncContext *s, int failed)
+{
+    MPVLookahead *la = s->lookahead;
+
+    la->running = 0;
+    la->valid   = !failed;
+    av_frame_unref(la->src);
+}
+
+/**
+ * Take over the motion estimated by lookahead_start() if it was done with
+ * the same parameters as estimating it now would use.
+ *
+ * @return 1 if the motion of the current picture is estimated, 0 otherwise
+ */
+static int lookahead_finish(MpegEncContext *s)
+{
+    MPVLookahead *la = s->lookahead;
+    const MpegEncContext *ctx;
+
+    if (!la || !la->valid)
+        return 0;
+    la->valid = 0;
+    ctx = la->ctx;
+
+    if (s->reordered_input_picture[0] != la->pic        ||
+        s->new_picture.f->data[0]     != la->src_data   ||
+        s->pict_type        != AV_PICTURE_TYPE_B        ||
+        s->last_picture_ptr != ctx->last_picture_ptr    ||
+        s->next_picture_ptr != ctx->next_picture_ptr    ||
+        s->lambda  != ctx->lambda  || s->lambda2     != ctx->lambda2     ||
+        s->qscale  != ctx->qscale  || s->no_rounding != ctx->no_rounding ||
+        s->f_code  != ctx->f_code  || s->b_code      != ctx->b_code      ||
+        s->pp_time != ctx->pp_time || s->pb_time     != ctx->pb_time)
+        return 0;
+
+    lookahead_copy_tables(s, la, 0);
+    memcpy(s->current_picture.mc_mb_var, la->mc_mb_var,
+           la->mb_array_size * sizeof(*la->mc_mb_var));
+    s->me.mc_mb_var_sum_temp = ctx->me.mc_mb_var_sum_temp;
+    s->me.mb_var_sum_temp    = ctx->me.mb_var_sum_temp;
+    /* the first MB of the next estimation starts with these */
+    s->me.penalty_factor     = ctx->me.penalty_factor;
+    s->me.sub_penalty_factor = ctx->me.sub_penalty_factor;
+    s->me.mb_penalty_factor  = ctx->me.mb_penalty_factor;
+    return 1;
+}
+
 static int encode_picture(MpegEncContext *s, int picture_number)
 {
     int i, ret;
@@ -3538,7 +3875,8 @@ static int encode_picture(MpegEncContext *s, int picture_number)
             }
         }
 
-        s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+        if (s->pict_type != AV_PICTURE_TYPE_B || !lookahead_finish(s))
+            s->avctx->execute(s->avctx, estimate_motion_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     }else /* if(s->pict_type == AV_PICTURE_TYPE_I) */{
         /* I-Frame */
         for(i=0; i<s->mb_stride*s->mb_height; i++)
@@ -3738,7 +4076,16 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     for(i=1; i<context_count; i++){
         update_duplicate_context_after_me(s->thread_context[i], s);
     }
-    s->avctx->execute(s->avctx, encode_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+    ret = lookahead_start(s);
+    if (ret < 0)
+        return ret;
+    if (ret) {
+        int job_ret[2];
+
+        s->avctx->execute2(s->avctx, lookahead_thread, s, job_ret, 2);
+        lookahead_end(s, job_ret[0] < 0);
+    } else
+        s->avctx->execute(s->avctx, encode_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
     for(i=1; i<context_count; i++){
         if (s->pb.buf_end == s->thread_context[i]->pb.buf)
             set_put_bits_buffer_size(&s->pb, FFMIN(s->thread_context[i]->pb.buf_end - s->pb.buf, INT_MAX/8-BUF_BITS));
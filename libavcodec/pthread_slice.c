@@ -165,6 +165,7 @@ int ff_slice_thread_init(AVCodecContext *avctx)
         return 0;
     }
     avctx->thread_count = thread_count;
+    avpriv_slicethread_set_priority(c->thread, AVPRIV_SLICETHREAD_PRIORITY_CODEC);
 
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
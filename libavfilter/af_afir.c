@@ -58,11 +58,15 @@ static void fcmul_add_c(float *sum, const float *t, const float *c, ptrdiff_t le
     sum[2 * n] += t[2 * n] * c[2 * n];
 }
 
-static void direct(const float *in, const AVComplexFloat *ir, int len, float *out)
+static void direct(const float *in, const float *ir, int nb_taps, int len, float *out)
 {
-    for (int n = 0; n < len; n++)
-        for (int m = 0; m <= n; m++)
-            out[n] += ir[m].re * in[n - m];
+    for (int n = 0; n < len; n++) {
+        float sum = 0.f;
+
+        for (int m = 0; m < nb_taps; m++)
+            sum += ir[m] * in[n + m];
+        out[n] = sum;
+    }
 }
 
 static void fir_fadd(AudioFIRContext *s, float *dst, const float *src, int nb_samples)
@@ -110,28 +114,13 @@ static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
         }
 
         if (seg->part_size < 8) {
-            memset(dst, 0, sizeof(*dst) * seg->part_size * seg->nb_partitions);
-
-            j = seg->part_index[ch];
-
-            for (i = 0; i < seg->nb_partitions; i++) {
-                const int coffset = j * seg->coeff_size;
-                const AVComplexFloat *coeff = (const AVComplexFloat *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
+            const float *ir = (const float *)seg->coeff->extended_data[ch * !s->one2many];
 
-                direct(src, coeff, nb_samples, dst);
-
-                if (j == 0)
-                    j = seg->nb_partitions;
-                j--;
-            }
-
-            seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
+            direct(src, ir, seg->nb_partitions * seg->part_size, nb_samples, dst);
 
             memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
 
-            for (n = 0; n < nb_samples; n++) {
-                ptr[n] += dst[n];
-            }
+            fir_fadd(s, ptr, dst, nb_samples);
             continue;
         }
 
@@ -385,8 +374,11 @@ static int init_segment(AVFilterContext *ctx, AudioFIRSegment *seg,
     seg->block_size    = FFALIGN(seg->fft_length, 32);
     seg->coeff_size    = FFALIGN(seg->part_size + 1, 32);
     seg->nb_partitions = nb_partitions;
-    seg->input_size    = offset + s->min_part_size;
     seg->input_offset  = offset;
+    /* the direct form head keeps the history its taps reach back into */
+    if (part_size < 8)
+        seg->input_offset += nb_partitions * part_size - 1;
+    seg->input_size    = seg->input_offset + s->min_part_size;
 
     seg->part_index    = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->part_index));
     seg->output_offset = av_calloc(ctx->inputs[0]->channels, sizeof(*seg->output_offset));
@@ -394,7 +386,7 @@ static int init_segment(AVFilterContext *ctx, AudioFIRSegment *seg,
         return AVERROR(ENOMEM);
 
     for (int ch = 0; ch < ctx->inputs[0]->channels && part_size >= 8; ch++) {
-        float scale = 1.f, iscale = 1.f / part_size;
+        float scale = 1.f, iscale = 0.5f / part_size;
         av_tx_init(&seg->tx[ch],  &seg->tx_fn,  AV_TX_FLOAT_RDFT, 0, 2 * part_size, &scale,  0);
         av_tx_init(&seg->itx[ch], &seg->itx_fn, AV_TX_FLOAT_RDFT, 1, 2 * part_size, &iscale, 0);
         if (!seg->tx[ch] || !seg->itx[ch])
@@ -473,7 +465,14 @@ static int convert_coeffs(AVFilterContext *ctx)
 
         for (i = 0; left > 0; i++) {
             int step = part_size == max_part_size ? INT_MAX : 1 + (i == 0);
-            int nb_partitions = FFMIN(step, (left + part_size - 1) / part_size);
+            int nb_partitions;
+
+            /* partitions shorter than 8 taps are merged into a single
+             * direct form segment convolving the first 8 taps every
+             * quantum, the FFT segments follow from there */
+            if (part_size < 8)
+                step = 8 / part_size;
+            nb_partitions = FFMIN(step, (left + part_size - 1) / part_size);
 
             s->nb_segments = i + 1;
             ret = init_segment(ctx, &s->seg[i], offset, nb_partitions, part_size);
@@ -481,7 +480,7 @@ static int convert_coeffs(AVFilterContext *ctx)
                 return ret;
             offset += nb_partitions * part_size;
             left -= nb_partitions * part_size;
-            part_size *= 2;
+            part_size = part_size < 8 ? 8 : part_size * 2;
             part_size = FFMIN(part_size, max_part_size);
         }
     }
@@ -563,19 +562,24 @@ static int convert_coeffs(AVFilterContext *ctx)
 
             av_log(ctx, AV_LOG_DEBUG, "segment: %d\n", segment);
 
+            if (seg->part_size < 8) {
+                const int nb_seg_taps = seg->nb_partitions * seg->part_size;
+                float *ir = (float *)coeff;
+
+                for (n = 0; n < nb_seg_taps; n++) {
+                    const int idx = toffset + nb_seg_taps - 1 - n;
+                    ir[n] = idx < s->nb_taps ? time[idx] : 0.f;
+                }
+
+                toffset += nb_seg_taps;
+                continue;
+            }
+
             for (i = 0; i < seg->nb_partitions; i++) {
                 const int coffset = i * seg->coeff_size;
                 const int remaining = s->nb_taps - toffset;
                 const int size = remaining >= seg->part_size ? seg->part_size : remaining;
 
-                if (size < 8) {
-                    for (n = 0; n < size; n++)
-                        coeff[coffset + n].re = time[toffset + n];
-
-                    toffset += size;
-                    continue;
-                }
-
                 memset(blockin, 0, sizeof(*blockin) * seg->fft_length);
                 memcpy(blockin, time + toffset, size * sizeof(*blockin));
 
@@ -396,6 +396,13 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate filters which do not depend on each other, such as the
+ * branches following a split filter, concurrently. Only valid for
+ * AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_BRANCH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -48,6 +48,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "branch", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_BRANCH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
@@ -1324,6 +1325,75 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static int filter_is_neighbour(AVFilterContext *filter, AVFilterContext *other)
+{
+    unsigned i;
+
+    if (filter == other)
+        return 1;
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i] && filter->inputs[i]->src == other)
+            return 1;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i] && filter->outputs[i]->dst == other)
+            return 1;
+    return 0;
+}
+
+/**
+ * Check whether two filters can be activated concurrently: activating a
+ * filter touches its own links and the ready status of its neighbours, so
+ * the two filters must neither be linked nor have a common neighbour.
+ */
+static int filters_independent(AVFilterContext *a, AVFilterContext *b)
+{
+    unsigned i;
+
+    if (filter_is_neighbour(a, b))
+        return 0;
+    for (i = 0; i < b->nb_inputs; i++)
+        if (b->inputs[i] && filter_is_neighbour(a, b->inputs[i]->src))
+            return 0;
+    for (i = 0; i < b->nb_outputs; i++)
+        if (b->outputs[i] && filter_is_neighbour(a, b->outputs[i]->dst))
+            return 0;
+    return 1;
+}
+
+/**
+ * Activate filter together with as many other filters of the same
+ * readiness as possible, as long as they are independent of each other.
+ * Sinks are always activated alone, as consuming from their inputs updates
+ * the graph-wide heap of sink links.
+ */
+static int run_branches(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    AVFilterContext *branches[MAX_BRANCHES];
+    int nb_branches = 1, max_branches = FFMIN(graph->nb_threads, MAX_BRANCHES);
+    unsigned i;
+    int j;
+
+    if (!filter->nb_outputs)
+        return ff_filter_activate(filter);
+
+    branches[0] = filter;
+    for (i = 0; i < graph->nb_filters && nb_branches < max_branches; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (f == filter || f->ready != filter->ready || !f->nb_outputs)
+            continue;
+        for (j = 0; j < nb_branches; j++)
+            if (!filters_independent(f, branches[j]))
+                break;
+        if (j == nb_branches)
+            branches[nb_branches++] = f;
+    }
+
+    if (nb_branches == 1)
+        return ff_filter_activate(filter);
+    return graph->internal->branch_execute(graph, branches, nb_branches);
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
@@ -1336,5 +1406,7 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+    if (graph->internal->branch_execute)
+        return run_branches(graph, filter);
     return ff_filter_activate(filter);
 }
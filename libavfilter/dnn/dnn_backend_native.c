@@ -25,6 +25,7 @@
 
 #include "dnn_backend_native.h"
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "dnn_backend_native_layer_conv2d.h"
 #include "dnn_backend_native_layers.h"
 #include "dnn_io_proc.h"
@@ -33,8 +34,9 @@
 #define OFFSET(x) offsetof(NativeContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption dnn_native_options[] = {
-    { "conv2d_threads", "threads num for conv2d layer", OFFSET(options.conv2d_threads), AV_OPT_TYPE_INT,  { .i64 = 0 }, INT_MIN, INT_MAX, FLAGS },
+    { "conv2d_threads", "threads num for conv2d and dense layers", OFFSET(options.conv2d_threads), AV_OPT_TYPE_INT,  { .i64 = 0 }, INT_MIN, INT_MAX, FLAGS },
     { "async",          "use DNN async inference",      OFFSET(options.async),          AV_OPT_TYPE_BOOL, { .i64 = 0 },       0,       1, FLAGS },
+    { "batch_size",     "batch size per request",       OFFSET(options.batch_size),     AV_OPT_TYPE_INT,  { .i64 = 1 },       1,    1000, FLAGS },
     { NULL },
 };
 
@@ -46,7 +48,10 @@ static const AVClass dnn_native_class = {
     .category   = AV_CLASS_CATEGORY_FILTER,
 };
 
-static DNNReturnType execute_model_native(Queue *lltask_queue);
+static DNNReturnType execute_model_native(NativeRequestItem *request, Queue *lltask_queue);
+static DNNReturnType native_start_inference(void *args);
+static void infer_completion_callback(void *args);
+static inline void destroy_request_item(NativeRequestItem **arg);
 
 static DNNReturnType extract_lltask_from_task(TaskItem *task, Queue *lltask_queue)
 {
@@ -102,6 +107,7 @@ static DNNReturnType get_output_native(void *model, const char *input_name, int
     DNNReturnType ret = 0;
     NativeModel *native_model = model;
     NativeContext *ctx = &native_model->ctx;
+    NativeRequestItem *request;
     TaskItem task;
     DNNExecBaseParams exec_params = {
         .input_name     = input_name,
@@ -122,7 +128,8 @@ static DNNReturnType get_output_native(void *model, const char *input_name, int
         goto err;
     }
 
-    ret = execute_model_native(native_model->lltask_queue);
+    request = ff_safe_queue_pop_front(native_model->request_queue);
+    ret = execute_model_native(request, native_model->lltask_queue);
     *output_width = task.out_frame->width;
     *output_height = task.out_frame->height;
 
@@ -144,6 +151,7 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename, DNNFunctionType f
     char buf[sizeof(DNN_NATIVE_MAGIC) - 1];
     int version, header_size, major_version_expected = 1;
     NativeModel *native_model = NULL;
+    NativeRequestItem *request;
     AVIOContext *model_file_context;
     int file_size, dnn_size, parsed_size;
     int32_t layer;
@@ -186,22 +194,21 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename, DNNFunctionType f
 
     native_model->ctx.class = &dnn_native_class;
     model->options = options;
+    av_opt_set_defaults(&native_model->ctx);
     if (av_opt_set_from_string(&native_model->ctx, model->options, NULL, "=", "&") < 0)
         goto fail;
     native_model->model = model;
 
+#if !HAVE_PTHREAD_CANCEL
     if (native_model->ctx.options.async) {
-        av_log(&native_model->ctx, AV_LOG_WARNING, "Async not supported. Rolling back to sync\n");
         native_model->ctx.options.async = 0;
-    }
-
-#if !HAVE_PTHREAD_CANCEL
-    if (native_model->ctx.options.conv2d_threads > 1){
-        av_log(&native_model->ctx, AV_LOG_WARNING, "'conv2d_threads' option was set but it is not supported "
-                       "on this build (pthread support is required)\n");
+        av_log(&native_model->ctx, AV_LOG_WARNING, "pthread is not supported, roll back to sync.\n");
     }
 #endif
 
+    if (ff_dnn_native_init_context(&native_model->ctx) < 0)
+        goto fail;
+
     avio_seek(model_file_context, file_size - 8, SEEK_SET);
     native_model->layers_num = (int32_t)avio_rl32(model_file_context);
     native_model->operands_num = (int32_t)avio_rl32(model_file_context);
@@ -228,6 +235,25 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename, DNNFunctionType f
         goto fail;
     }
 
+    // a single request: batches are executed one after the other,
+    // the next batch is gathered while the previous one runs
+    request = av_mallocz(sizeof(*request));
+    if (!request) {
+        goto fail;
+    }
+    request->lltasks = av_malloc_array(native_model->ctx.options.batch_size, sizeof(*request->lltasks));
+    request->exec_module.start_inference = &native_start_inference;
+    request->exec_module.callback = &infer_completion_callback;
+    request->exec_module.args = request;
+    native_model->request_queue = ff_safe_queue_create();
+    if (!request->lltasks || !native_model->request_queue ||
+        ff_safe_queue_push_back(native_model->request_queue, request) < 0) {
+        ff_safe_queue_destroy(native_model->request_queue);
+        native_model->request_queue = NULL;
+        destroy_request_item(&request);
+        goto fail;
+    }
+
     for (layer = 0; layer < native_model->layers_num; ++layer){
         layer_type = (int32_t)avio_rl32(model_file_context);
         dnn_size += 4;
@@ -297,40 +323,53 @@ fail:
     return NULL;
 }
 
-static DNNReturnType execute_model_native(Queue *lltask_queue)
+static void release_lltasks(NativeRequestItem *request)
 {
-    NativeModel *native_model = NULL;
-    NativeContext *ctx = NULL;
-    int32_t layer;
-    DNNData input, output;
-    DnnOperand *oprd = NULL;
-    LastLevelTaskItem *lltask = NULL;
-    TaskItem *task = NULL;
-    DNNReturnType ret = 0;
+    for (int i = 0; i < request->lltask_count; i++)
+        av_freep(&request->lltasks[i]);
+    request->lltask_count = 0;
+}
 
-    lltask = ff_queue_pop_front(lltask_queue);
-    if (!lltask) {
-        av_log(NULL, AV_LOG_ERROR, "Failed to get LastLevelTaskItem\n");
-        ret = DNN_ERROR;
-        goto err;
-    }
-    task = lltask->task;
-    native_model = task->model;
-    ctx = &native_model->ctx;
+static inline void destroy_request_item(NativeRequestItem **arg)
+{
+    NativeRequestItem *request = *arg;
+    if (!request)
+        return;
+    ff_dnn_async_module_cleanup(&request->exec_module);
+    release_lltasks(request);
+    av_freep(&request->lltasks);
+    av_freep(arg);
+}
 
-    if (native_model->layers_num <= 0 || native_model->operands_num <= 0) {
-        av_log(ctx, AV_LOG_ERROR, "No operands or layers in model\n");
-        ret = DNN_ERROR;
-        goto err;
+static void push_back_request(NativeModel *native_model, NativeRequestItem *request)
+{
+    if (ff_safe_queue_push_back(native_model->request_queue, request) < 0) {
+        destroy_request_item(&request);
+        av_log(&native_model->ctx, AV_LOG_ERROR, "Failed to push back request_queue.\n");
     }
+}
+
+/**
+ * Move up to batch_size frames of the same size from the front of
+ * lltask_queue into the request and convert them into the input operand.
+ */
+static DNNReturnType fill_model_input_native(NativeModel *native_model, NativeRequestItem *request,
+                                             Queue *lltask_queue)
+{
+    NativeContext *ctx = &native_model->ctx;
+    LastLevelTaskItem *lltask = ff_queue_peek_front(lltask_queue);
+    TaskItem *task = lltask->task;
+    DnnOperand *oprd = NULL;
+    DNNData input;
+    int32_t input_length;
+    size_t frame_size;
 
     for (int i = 0; i < native_model->operands_num; ++i) {
         oprd = &native_model->operands[i];
         if (strcmp(oprd->name, task->input_name) == 0) {
             if (oprd->type != DOT_INPUT) {
                 av_log(ctx, AV_LOG_ERROR, "Found \"%s\" in model, but it is not input node\n", task->input_name);
-                ret = DNN_ERROR;
-                goto err;
+                return DNN_ERROR;
             }
             break;
         }
@@ -338,25 +377,42 @@ static DNNReturnType execute_model_native(Queue *lltask_queue)
     }
     if (!oprd) {
         av_log(ctx, AV_LOG_ERROR, "Could not find \"%s\" in model\n", task->input_name);
-        ret = DNN_ERROR;
-        goto err;
+        return DNN_ERROR;
+    }
+
+    if (task->nb_output != 1) {
+        // currently, the filter does not need multiple outputs,
+        // so we just pending the support until we really need it.
+        avpriv_report_missing_feature(ctx, "multiple outputs");
+        return DNN_ERROR;
     }
 
+    while (request->lltask_count < ctx->options.batch_size &&
+           (lltask = ff_queue_peek_front(lltask_queue))) {
+        const AVFrame *in_frame = lltask->task->in_frame;
+        if (in_frame->width != task->in_frame->width || in_frame->height != task->in_frame->height)
+            break;
+        request->lltasks[request->lltask_count++] = ff_queue_pop_front(lltask_queue);
+    }
+
+    oprd->dims[0] = request->lltask_count;
     oprd->dims[1] = task->in_frame->height;
     oprd->dims[2] = task->in_frame->width;
 
-    av_freep(&oprd->data);
-    oprd->length = ff_calculate_operand_data_length(oprd);
-    if (oprd->length <= 0) {
+    input_length = ff_calculate_operand_data_length(oprd);
+    if (input_length <= 0) {
         av_log(ctx, AV_LOG_ERROR, "The input data length overflow\n");
-        ret = DNN_ERROR;
-        goto err;
+        return DNN_ERROR;
     }
-    oprd->data = av_malloc(oprd->length);
-    if (!oprd->data) {
-        av_log(ctx, AV_LOG_ERROR, "Failed to malloc memory for input data\n");
-        ret = DNN_ERROR;
-        goto err;
+    // keep the input buffer of the previous batch if it has the same size
+    if (!oprd->data || oprd->length != input_length) {
+        av_freep(&oprd->data);
+        oprd->length = input_length;
+        oprd->data = av_malloc(oprd->length);
+        if (!oprd->data) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to malloc memory for input data\n");
+            return DNN_ERROR;
+        }
     }
 
     input.height = oprd->dims[1];
@@ -364,57 +420,83 @@ static DNNReturnType execute_model_native(Queue *lltask_queue)
     input.channels = oprd->dims[3];
     input.data = oprd->data;
     input.dt = oprd->data_type;
-    if (task->do_ioproc) {
-        if (native_model->model->frame_pre_proc != NULL) {
-            native_model->model->frame_pre_proc(task->in_frame, &input, native_model->model->filter_ctx);
-        } else {
-            ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+    frame_size = oprd->length / request->lltask_count;
+
+    for (int i = 0; i < request->lltask_count; i++) {
+        task = request->lltasks[i]->task;
+        if (task->do_ioproc) {
+            if (native_model->model->frame_pre_proc != NULL) {
+                native_model->model->frame_pre_proc(task->in_frame, &input, native_model->model->filter_ctx);
+            } else {
+                ff_proc_from_frame_to_dnn(task->in_frame, &input, ctx);
+            }
         }
+        input.data = (uint8_t *)input.data + frame_size;
     }
 
-    if (task->nb_output != 1) {
-        // currently, the filter does not need multiple outputs,
-        // so we just pending the support until we really need it.
-        avpriv_report_missing_feature(ctx, "multiple outputs");
-        ret = DNN_ERROR;
-        goto err;
-    }
+    return DNN_SUCCESS;
+}
 
-    for (layer = 0; layer < native_model->layers_num; ++layer){
+/**
+ * Run the layers of the model on the input operand filled by
+ * fill_model_input_native().
+ */
+static DNNReturnType native_start_inference(void *args)
+{
+    NativeRequestItem *request = args;
+    TaskItem *task = request->lltasks[0]->task;
+    NativeModel *native_model = task->model;
+
+    for (int32_t layer = 0; layer < native_model->layers_num; ++layer){
         DNNLayerType layer_type = native_model->layers[layer].type;
         if (ff_layer_funcs[layer_type].pf_exec(native_model->operands,
                                             native_model->layers[layer].input_operand_indexes,
                                             native_model->layers[layer].output_operand_index,
                                             native_model->layers[layer].params,
                                             &native_model->ctx) == DNN_ERROR) {
-            av_log(ctx, AV_LOG_ERROR, "Failed to execute model\n");
-            ret = DNN_ERROR;
-            goto err;
+            av_log(&native_model->ctx, AV_LOG_ERROR, "Failed to execute model\n");
+            release_lltasks(request);
+            push_back_request(native_model, request);
+            return DNN_ERROR;
         }
     }
+    return DNN_SUCCESS;
+}
 
-    for (uint32_t i = 0; i < task->nb_output; ++i) {
-        DnnOperand *oprd = NULL;
-        const char *output_name = task->output_names[i];
-        for (int j = 0; j < native_model->operands_num; ++j) {
-            if (strcmp(native_model->operands[j].name, output_name) == 0) {
-                oprd = &native_model->operands[j];
-                break;
-            }
-        }
+/**
+ * Scatter the output operand to the frames of the batch.
+ */
+static void infer_completion_callback(void *args)
+{
+    NativeRequestItem *request = args;
+    TaskItem *task = request->lltasks[0]->task;
+    NativeModel *native_model = task->model;
+    NativeContext *ctx = &native_model->ctx;
+    DnnOperand *oprd = NULL;
+    DNNData output;
+    size_t frame_size;
 
-        if (oprd == NULL) {
-            av_log(ctx, AV_LOG_ERROR, "Could not find output in model\n");
-            ret = DNN_ERROR;
-            goto err;
+    for (int j = 0; j < native_model->operands_num; ++j) {
+        if (strcmp(native_model->operands[j].name, task->output_names[0]) == 0) {
+            oprd = &native_model->operands[j];
+            break;
         }
+    }
+
+    if (oprd == NULL) {
+        av_log(ctx, AV_LOG_ERROR, "Could not find output in model\n");
+        goto err;
+    }
 
-        output.data = oprd->data;
-        output.height = oprd->dims[1];
-        output.width = oprd->dims[2];
-        output.channels = oprd->dims[3];
-        output.dt = oprd->data_type;
+    output.data = oprd->data;
+    output.height = oprd->dims[1];
+    output.width = oprd->dims[2];
+    output.channels = oprd->dims[3];
+    output.dt = oprd->data_type;
+    frame_size = oprd->length / request->lltask_count;
 
+    for (int i = 0; i < request->lltask_count; i++) {
+        task = request->lltasks[i]->task;
         if (task->do_ioproc) {
             if (native_model->model->frame_post_proc != NULL) {
                 native_model->model->frame_post_proc(task->out_frame, &output, native_model->model->filter_ctx);
@@ -425,11 +507,53 @@ static DNNReturnType execute_model_native(Queue *lltask_queue)
             task->out_frame->width = output.width;
             task->out_frame->height = output.height;
         }
+        task->inference_done++;
+        output.data = (uint8_t *)output.data + frame_size;
     }
-    task->inference_done++;
 err:
-    av_freep(&lltask);
-    return ret;
+    release_lltasks(request);
+    push_back_request(native_model, request);
+}
+
+static DNNReturnType execute_model_native(NativeRequestItem *request, Queue *lltask_queue)
+{
+    NativeModel *native_model;
+    NativeContext *ctx;
+    LastLevelTaskItem *lltask;
+    TaskItem *task;
+
+    lltask = ff_queue_peek_front(lltask_queue);
+    if (!lltask) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to get LastLevelTaskItem\n");
+        return DNN_ERROR;
+    }
+    task = lltask->task;
+    native_model = task->model;
+    ctx = &native_model->ctx;
+
+    if (native_model->layers_num <= 0 || native_model->operands_num <= 0) {
+        av_log(ctx, AV_LOG_ERROR, "No operands or layers in model\n");
+        goto err;
+    }
+
+    if (fill_model_input_native(native_model, request, lltask_queue) != DNN_SUCCESS)
+        goto err;
+
+    if (task->async) {
+        if (ff_dnn_start_inference_async(ctx, &request->exec_module) != DNN_SUCCESS)
+            goto err;
+        return DNN_SUCCESS;
+    }
+
+    if (native_start_inference(request) != DNN_SUCCESS)
+        return DNN_ERROR;
+    infer_completion_callback(request);
+    return (task->inference_done == task->inference_todo) ? DNN_SUCCESS : DNN_ERROR;
+
+err:
+    release_lltasks(request);
+    push_back_request(native_model, request);
+    return DNN_ERROR;
 }
 
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNExecBaseParams *exec_params)
@@ -464,21 +588,31 @@ DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNExecBasePara
         return DNN_ERROR;
     }
 
-    return execute_model_native(native_model->lltask_queue);
+    // the frames wait in lltask_queue until there are enough of them for
+    // a batch, popping the request waits for the previous batch to finish
+    while (ff_queue_size(native_model->lltask_queue) >= ctx->options.batch_size) {
+        NativeRequestItem *request = ff_safe_queue_pop_front(native_model->request_queue);
+        DNNReturnType ret = execute_model_native(request, native_model->lltask_queue);
+        if (ret != DNN_SUCCESS)
+            return ret;
+    }
+
+    return DNN_SUCCESS;
 }
 
 DNNReturnType ff_dnn_flush_native(const DNNModel *model)
 {
     NativeModel *native_model = model->model;
 
-    if (ff_queue_size(native_model->lltask_queue) == 0) {
-        // no pending task need to flush
-        return DNN_SUCCESS;
+    // run the incomplete batches left, a size change may have split them
+    while (ff_queue_size(native_model->lltask_queue) != 0) {
+        NativeRequestItem *request = ff_safe_queue_pop_front(native_model->request_queue);
+        DNNReturnType ret = execute_model_native(request, native_model->lltask_queue);
+        if (ret != DNN_SUCCESS)
+            return ret;
     }
 
-    // for now, use sync node with flush operation
-    // Switch to async when it is supported
-    return execute_model_native(native_model->lltask_queue);
+    return DNN_SUCCESS;
 }
 
 DNNAsyncStatusType ff_dnn_get_result_native(const DNNModel *model, AVFrame **in, AVFrame **out)
@@ -508,6 +642,88 @@ int32_t ff_calculate_operand_data_length(const DnnOperand* oprd)
     return len;
 }
 
+static void native_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    NativeContext *ctx = priv;
+    ctx->job_func(ctx->job_arg, jobnr, threadnr, nb_jobs);
+}
+
+int ff_dnn_native_init_context(NativeContext *ctx)
+{
+    int nb_threads = ctx->options.conv2d_threads;
+    int ret;
+
+    ctx->fdsp = avpriv_float_dsp_alloc(0);
+    if (!ctx->fdsp)
+        return AVERROR(ENOMEM);
+
+    if (nb_threads <= 0 || nb_threads > av_cpu_count())
+        nb_threads = 0;
+    if (nb_threads == 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&ctx->slicethread, ctx, native_worker_func, NULL, nb_threads);
+    if (ret == AVERROR(ENOSYS)) {
+        if (nb_threads > 1)
+            av_log(ctx, AV_LOG_WARNING, "'conv2d_threads' option was set but it is not supported "
+                   "on this build (thread support is required)\n");
+        return 0;
+    }
+    if (ret < 0)
+        return ret;
+    if (ret <= 1) {
+        avpriv_slicethread_free(&ctx->slicethread);
+        return 0;
+    }
+    avpriv_slicethread_set_priority(ctx->slicethread, AVPRIV_SLICETHREAD_PRIORITY_FILTER);
+    ctx->nb_threads = ret;
+    return 0;
+}
+
+void ff_dnn_native_uninit_context(NativeContext *ctx)
+{
+    avpriv_slicethread_free(&ctx->slicethread);
+    ctx->nb_threads = 0;
+    av_freep(&ctx->fdsp);
+    for (int i = 0; i < NATIVE_BUFFER_NB; i++) {
+        av_freep(&ctx->buffers[i]);
+        ctx->buffer_sizes[i] = 0;
+    }
+}
+
+int ff_dnn_native_nb_threads(const NativeContext *ctx)
+{
+    return ctx && ctx->slicethread ? ctx->nb_threads : 1;
+}
+
+void ff_dnn_native_execute(NativeContext *ctx, NativeJobFunc func, void *arg, int nb_jobs)
+{
+    if (ctx && ctx->slicethread && nb_jobs > 1) {
+        ctx->job_func = func;
+        ctx->job_arg  = arg;
+        avpriv_slicethread_execute(ctx->slicethread, nb_jobs, 0);
+    } else {
+        for (int i = 0; i < nb_jobs; i++)
+            func(arg, i, 0, nb_jobs);
+    }
+}
+
+void *ff_dnn_native_get_buffer(NativeContext *ctx, NativeBufferType type, size_t size)
+{
+    if (!ctx)
+        return av_malloc(size);
+    if (size > UINT_MAX)
+        return NULL;
+    av_fast_malloc(&ctx->buffers[type], &ctx->buffer_sizes[type], size);
+    return ctx->buffers[type];
+}
+
+void ff_dnn_native_release_buffer(NativeContext *ctx, void *buf)
+{
+    if (!ctx)
+        av_free(buf);
+}
+
 void ff_dnn_free_model_native(DNNModel **model)
 {
     NativeModel *native_model;
@@ -518,6 +734,13 @@ void ff_dnn_free_model_native(DNNModel **model)
     {
         if ((*model)->model) {
             native_model = (*model)->model;
+            if (native_model->request_queue) {
+                // waits for the batch in flight, if any
+                NativeRequestItem *request = ff_safe_queue_pop_front(native_model->request_queue);
+                destroy_request_item(&request);
+                ff_safe_queue_destroy(native_model->request_queue);
+            }
+
             if (native_model->layers) {
                 for (layer = 0; layer < native_model->layers_num; ++layer){
                     if (native_model->layers[layer].type == DLT_CONV2D){
@@ -550,6 +773,7 @@ void ff_dnn_free_model_native(DNNModel **model)
             }
             ff_queue_destroy(native_model->task_queue);
 
+            ff_dnn_native_uninit_context(&native_model->ctx);
             av_freep(&native_model);
         }
         av_freep(model);
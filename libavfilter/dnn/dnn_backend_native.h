@@ -29,8 +29,12 @@
 
 #include "../dnn_interface.h"
 #include "libavformat/avio.h"
+#include "libavutil/float_dsp.h"
 #include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
+#include "dnn_backend_common.h"
 #include "queue.h"
+#include "safe_queue.h"
 
 /**
  * the enum value of DNNLayerType should not be changed,
@@ -113,11 +117,37 @@ typedef struct InputParams{
 typedef struct NativeOptions{
     uint8_t async;
     uint32_t conv2d_threads;
+    int batch_size;
 } NativeOptions;
 
+typedef enum {
+    NATIVE_BUFFER_WEIGHTS,  ///< packed weights of the running layer
+    NATIVE_BUFFER_SCRATCH,  ///< per-thread partial sums and im2col rows
+    NATIVE_BUFFER_NB
+} NativeBufferType;
+
+typedef void (*NativeJobFunc)(void *arg, int jobnr, int threadnr, int nb_jobs);
+
 typedef struct NativeContext {
     const AVClass *class;
     NativeOptions options;
+
+    /**
+     * Worker threads kept for the lifetime of the model, NULL if the layers
+     * run on the calling thread only.
+     */
+    AVSliceThread *slicethread;
+    int nb_threads;
+    NativeJobFunc job_func;
+    void *job_arg;
+
+    AVFloatDSPContext *fdsp;
+
+    /**
+     * Buffers reused by the layers from one frame to the next.
+     */
+    void *buffers[NATIVE_BUFFER_NB];
+    unsigned int buffer_sizes[NATIVE_BUFFER_NB];
 } NativeContext;
 
 // Represents simple feed-forward convolutional network.
@@ -128,10 +158,21 @@ typedef struct NativeModel{
     int32_t layers_num;
     DnnOperand *operands;
     int32_t operands_num;
+    SafeQueue *request_queue;
     Queue *task_queue;
     Queue *lltask_queue;
 } NativeModel;
 
+/**
+ * Frames run through the model in one batch. The operands belong to the
+ * model, so there is only one request and at most one batch in flight.
+ */
+typedef struct NativeRequestItem {
+    LastLevelTaskItem **lltasks;
+    int lltask_count;
+    DNNAsyncExecModule exec_module;
+} NativeRequestItem;
+
 DNNModel *ff_dnn_load_model_native(const char *model_filename, DNNFunctionType func_type, const char *options, AVFilterContext *filter_ctx);
 
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNExecBaseParams *exec_params);
@@ -142,6 +183,37 @@ DNNReturnType ff_dnn_flush_native(const DNNModel *model);
 
 void ff_dnn_free_model_native(DNNModel **model);
 
+/**
+ * Start the worker threads requested by the options of ctx.
+ * The rest of ctx must have been zeroed.
+ */
+int ff_dnn_native_init_context(NativeContext *ctx);
+
+/**
+ * Stop the worker threads and free the buffers of ctx.
+ */
+void ff_dnn_native_uninit_context(NativeContext *ctx);
+
+/**
+ * @return number of threads the jobs of ff_dnn_native_execute() may run on,
+ * threadnr passed to the jobs is below this value
+ */
+int ff_dnn_native_nb_threads(const NativeContext *ctx);
+
+/**
+ * Run nb_jobs jobs, on the worker threads of ctx if there are any.
+ * ctx may be NULL.
+ */
+void ff_dnn_native_execute(NativeContext *ctx, NativeJobFunc func, void *arg, int nb_jobs);
+
+/**
+ * Get a buffer of at least size bytes, which stays allocated in ctx until
+ * it is asked for with a larger size. If ctx is NULL, the buffer is
+ * allocated and must be freed with ff_dnn_native_release_buffer().
+ */
+void *ff_dnn_native_get_buffer(NativeContext *ctx, NativeBufferType type, size_t size);
+void ff_dnn_native_release_buffer(NativeContext *ctx, void *buf);
+
 // NOTE: User must check for error (return value <= 0) to handle
 // case like integer overflow.
 int32_t ff_calculate_operand_data_length(const DnnOperand *oprd);
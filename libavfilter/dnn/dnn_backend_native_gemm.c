@@ -0,0 +1,126 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+#include "dnn_backend_native_gemm.h"
+
+#define MC DNN_GEMM_MC
+
+/**
+ * number of weight rows applied to all MC rows of src before moving on,
+ * so that they stay in L1
+ */
+#define KC 64
+
+/* vector_fmac_scalar() works on multiples of 16 floats */
+#define CHANNEL_ALIGN 16
+
+/*
+ * Packed layout: the biases padded to a multiple of CHANNEL_ALIGN,
+ * followed by k rows holding the weight of each output channel for one
+ * input, padded with zeros the same way.
+ */
+size_t ff_dnn_gemm_packed_size(int n, int k)
+{
+    size_t n_pad = FFALIGN(n, CHANNEL_ALIGN);
+    return n_pad + n_pad * k;
+}
+
+size_t ff_dnn_gemm_scratch_size(int n)
+{
+    return (size_t)MC * FFALIGN(n, CHANNEL_ALIGN);
+}
+
+void ff_dnn_gemm_pack(float *dst, const float *weights, const float *biases,
+                      int n, int k)
+{
+    int n_pad = FFALIGN(n, CHANNEL_ALIGN);
+
+    for (int j = 0; j < n_pad; j++)
+        *dst++ = biases && j < n ? biases[j] : 0.f;
+
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < n_pad; j++)
+            dst[j] = j < n ? weights[j * (size_t)k + i] : 0.f;
+        dst += n_pad;
+    }
+}
+
+static void vector_fmac_scalar_c(float *dst, const float *src, float mul, int len)
+{
+    for (int i = 0; i < len; i++)
+        dst[i] += src[i] * mul;
+}
+
+static av_always_inline float activate(float x, DNNActivationFunc activation)
+{
+    switch (activation) {
+    case RELU:
+        return FFMAX(x, 0.0);
+    case TANH:
+        return 2.0f  / (1.0f + exp(-2.0f * x)) - 1.0f;
+    case SIGMOID:
+        return 1.0f / (1.0f + exp(-x));
+    case LEAKY_RELU:
+        return FFMAX(x, 0.0) + 0.2 * FFMIN(x, 0.0);
+    case NONE:
+    default:
+        return x;
+    }
+}
+
+void ff_dnn_gemm(float *dst, ptrdiff_t dst_stride,
+                 const float *src, ptrdiff_t src_stride,
+                 const float *packed, float *scratch, int m, int n, int k,
+                 DNNActivationFunc activation, const AVFloatDSPContext *fdsp)
+{
+    void (*fmac)(float *dst, const float *src, float mul, int len) =
+        fdsp ? fdsp->vector_fmac_scalar : vector_fmac_scalar_c;
+    const int n_pad = FFALIGN(n, CHANNEL_ALIGN);
+    const float *weights = packed + n_pad;
+
+    for (int m0 = 0; m0 < m; m0 += MC) {
+        const int mc = FFMIN(MC, m - m0);
+
+        for (int r = 0; r < mc; r++)
+            memcpy(scratch + r * n_pad, packed, n_pad * sizeof(*scratch));
+
+        for (int k0 = 0; k0 < k; k0 += KC) {
+            const int kc = FFMIN(KC, k - k0);
+            for (int r = 0; r < mc; r++) {
+                const float *a = src + (m0 + r) * src_stride + k0;
+                float *acc = scratch + r * n_pad;
+                for (int i = 0; i < kc; i++) {
+                    // zero inputs are common after ReLU and in padding
+                    if (a[i] != 0.f)
+                        fmac(acc, weights + (size_t)(k0 + i) * n_pad, a[i], n_pad);
+                }
+            }
+        }
+
+        for (int r = 0; r < mc; r++) {
+            const float *acc = scratch + r * n_pad;
+            float *out = dst + (m0 + r) * dst_stride;
+            for (int j = 0; j < n; j++)
+                out[j] = activate(acc[j], activation);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Matrix multiplication used by the native backend to run the conv2d
+ * (after im2col lowering) and dense layers.
+ */
+
+#ifndef AVFILTER_DNN_DNN_BACKEND_NATIVE_GEMM_H
+#define AVFILTER_DNN_DNN_BACKEND_NATIVE_GEMM_H
+
+#include <stddef.h>
+#include "libavutil/float_dsp.h"
+#include "dnn_backend_native.h"
+
+/**
+ * Maximum number of rows of src multiplied together, the partial sums of
+ * that many rows are kept in the scratch buffer.
+ */
+#define DNN_GEMM_MC 64
+
+/**
+ * @return number of floats needed for the packed weights of an
+ * N x K weight matrix
+ */
+size_t ff_dnn_gemm_packed_size(int n, int k);
+
+/**
+ * @return number of floats of the scratch buffer passed to ff_dnn_gemm()
+ */
+size_t ff_dnn_gemm_scratch_size(int n);
+
+/**
+ * Pack the weights of a layer for ff_dnn_gemm().
+ *
+ * @param dst       buffer of ff_dnn_gemm_packed_size() floats, 32-byte aligned
+ * @param weights   n rows of k weights, one row per output channel
+ * @param biases    n biases, may be NULL
+ */
+void ff_dnn_gemm_pack(float *dst, const float *weights, const float *biases,
+                      int n, int k);
+
+/**
+ * Compute dst[m][n] = activation(bias[n] + sum(src[m][i] * weights[n][i]))
+ * for m rows of src.
+ *
+ * @param dst        output rows of n floats
+ * @param dst_stride distance between output rows in floats
+ * @param src        input rows of k floats
+ * @param src_stride distance between input rows in floats
+ * @param packed     weights packed with ff_dnn_gemm_pack()
+ * @param scratch    buffer of ff_dnn_gemm_scratch_size() floats, 32-byte aligned
+ * @param fdsp       used for the multiply-adds, may be NULL
+ */
+void ff_dnn_gemm(float *dst, ptrdiff_t dst_stride,
+                 const float *src, ptrdiff_t src_stride,
+                 const float *packed, float *scratch, int m, int n, int k,
+                 DNNActivationFunc activation, const AVFloatDSPContext *fdsp);
+
+#endif
@@ -18,30 +18,26 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
 #include "libavutil/avassert.h"
-#include "libavutil/thread.h"
-#include "libavutil/cpu.h"
 #include "dnn_backend_native_layer_conv2d.h"
+#include "dnn_backend_native_gemm.h"
 
 #define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
 
 //struct to pass parameters
-typedef struct ThreadCommonParam{
-    DnnOperand *operands;
-    const int32_t *input_operand_indexes;
-    int32_t output_operand_index;
-    const void *parameters;
-    NativeContext *ctx;
-    float *output_data;
-} ThreadCommonParam;
-
-typedef struct ThreadParam{
-    ThreadCommonParam *thread_common_param;
-    int thread_start, thread_end;
-#if HAVE_PTHREAD_CANCEL
-    pthread_t thread;
-#endif
-} ThreadParam;
+typedef struct Conv2dJob{
+    const ConvolutionalParams *conv_params;
+    const float *input;
+    float *output;
+    const float *packed;
+    float *scratch;
+    size_t scratch_size;
+    const AVFloatDSPContext *fdsp;
+    int number, height, width;
+    int output_height, output_width;
+    int pad_size;
+} Conv2dJob;
 
 int ff_dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
 {
@@ -108,101 +104,92 @@ int ff_dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int
     return dnn_size;
 }
 
-static void * dnn_execute_layer_conv2d_thread(void *threadarg)
+/**
+ * Gather the input patches of nb_pixels output pixels of the input row y,
+ * starting at input column x, into rows laid out like the kernel weights.
+ */
+static void im2col(const Conv2dJob *job, float *dst, const float *input,
+                   int y, int x, int nb_pixels)
 {
-    //pass parameters
-    ThreadParam *thread_param = threadarg;
-    ThreadCommonParam *thread_common_param = thread_param->thread_common_param;
-    DnnOperand *operands = thread_common_param->operands;
-    int32_t input_operand_index = thread_common_param->input_operand_indexes[0];
-    int height = operands[input_operand_index].dims[1];
-    int width = operands[input_operand_index].dims[2];
-    int channel = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
-    const ConvolutionalParams *conv_params = thread_common_param->parameters;
-
+    const ConvolutionalParams *conv_params = job->conv_params;
     int radius = conv_params->kernel_size >> 1;
-    int src_linesize = width * conv_params->input_num;
-    int filter_linesize = conv_params->kernel_size * conv_params->input_num;
-    int filter_size = conv_params->kernel_size * filter_linesize;
-    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
-
-    float *output = thread_common_param->output_data;
-    output += (conv_params->output_num) * (width - 2 * pad_size) * (thread_param->thread_start - pad_size);
-
-    av_assert0(channel == conv_params->input_num);
-
-    for (int y = thread_param->thread_start; y < thread_param->thread_end; ++y) {
-        for (int x = pad_size; x < width - pad_size; ++x) {
-            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
-                if (conv_params->has_bias)
-                    output[n_filter] = conv_params->biases[n_filter];
+    int channel = conv_params->input_num;
+    int clamp = conv_params->padding_method == SAME_CLAMP_TO_EDGE;
+
+    for (int i = 0; i < nb_pixels; ++i) {
+        for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
+            int y_pos = y + (kernel_y - radius) * conv_params->dilation;
+            if (clamp)
+                y_pos = CLAMP_TO_EDGE(y_pos, job->height);
+            for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
+                int x_pos = x + i + (kernel_x - radius) * conv_params->dilation;
+                if (clamp)
+                    x_pos = CLAMP_TO_EDGE(x_pos, job->width);
+                if (x_pos < 0 || x_pos >= job->width || y_pos < 0 || y_pos >= job->height)
+                    memset(dst, 0, channel * sizeof(*dst));
                 else
-                    output[n_filter] = 0.f;
-
-                for (int ch = 0; ch < conv_params->input_num; ++ch) {
-                    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
-                        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
-                            float input_pel;
-                            if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
-                                int y_pos = CLAMP_TO_EDGE(y + (kernel_y - radius) * conv_params->dilation, height);
-                                int x_pos = CLAMP_TO_EDGE(x + (kernel_x - radius) * conv_params->dilation, width);
-                                input_pel = input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            } else {
-                                int y_pos = y + (kernel_y - radius) * conv_params->dilation;
-                                int x_pos = x + (kernel_x - radius) * conv_params->dilation;
-                                input_pel = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
-                                                   input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            }
-
-
-                            output[n_filter] += input_pel * conv_params->kernel[n_filter * filter_size + kernel_y * filter_linesize +
-                                                                                kernel_x * conv_params->input_num + ch];
-                        }
-                    }
-                }
-                switch (conv_params->activation){
-                case RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0);
-                    break;
-                case TANH:
-                    output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
-                    break;
-                case SIGMOID:
-                    output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
-                    break;
-                case NONE:
-                    break;
-                case LEAKY_RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
-                }
+                    memcpy(dst, input + ((size_t)y_pos * job->width + x_pos) * channel,
+                           channel * sizeof(*dst));
+                dst += channel;
             }
-            output += conv_params->output_num;
         }
     }
-    return NULL;
 }
 
+static void dnn_execute_layer_conv2d_job(void *arg, int jobnr, int threadnr, int nb_jobs)
+{
+    const Conv2dJob *job = arg;
+    const ConvolutionalParams *conv_params = job->conv_params;
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+    int output_num = conv_params->output_num;
+    int nb_rows = job->number * job->output_height;
+    int slice_start = (nb_rows *  jobnr     ) / nb_jobs;
+    int slice_end   = (nb_rows * (jobnr + 1)) / nb_jobs;
+    float *scratch = job->scratch + threadnr * job->scratch_size;
+    float *cols = conv_params->kernel_size > 1 ? scratch + ff_dnn_gemm_scratch_size(output_num) : NULL;
+
+    // the rows of all the images of the batch are split between the jobs
+    for (int row = slice_start; row < slice_end; ++row) {
+        int y = row % job->output_height;
+        const float *input = job->input + (size_t)(row / job->output_height) *
+                             job->height * job->width * conv_params->input_num;
+        float *output = job->output + (size_t)row * job->output_width * output_num;
+        for (int x = 0; x < job->output_width; x += DNN_GEMM_MC) {
+            int nb_pixels = FFMIN(DNN_GEMM_MC, job->output_width - x);
+            const float *src;
+
+            if (cols) {
+                im2col(job, cols, input, y + job->pad_size, x + job->pad_size, nb_pixels);
+                src = cols;
+            } else {
+                // 1x1 kernel, the input pixels are already laid out as rows
+                src = input + ((size_t)y * job->width + x) * conv_params->input_num;
+            }
+            ff_dnn_gemm(output + (size_t)x * output_num, output_num, src, filter_size,
+                        job->packed, scratch, nb_pixels, output_num, filter_size,
+                        conv_params->activation, job->fdsp);
+        }
+    }
+}
 
 int ff_dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
                                 int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
-#if HAVE_PTHREAD_CANCEL
-    int thread_num = (ctx->options.conv2d_threads <= 0 || ctx->options.conv2d_threads > av_cpu_count())
-        ? (av_cpu_count() + 1) : (ctx->options.conv2d_threads);
-    int ret = DNN_SUCCESS, thread_stride;
-    ThreadParam *thread_param;
-#else
-    ThreadParam thread_param = { 0 };
-#endif
-    ThreadCommonParam thread_common_param;
     const ConvolutionalParams *conv_params = parameters;
     int height = operands[input_operand_indexes[0]].dims[1];
     int width = operands[input_operand_indexes[0]].dims[2];
+    int channel = operands[input_operand_indexes[0]].dims[3];
     int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+    int nb_threads = ff_dnn_native_nb_threads(ctx);
     DnnOperand *output_operand = &operands[output_operand_index];
+    Conv2dJob job = { 0 };
+    float *packed, *scratch;
+    size_t scratch_size;
     void *tmp;
 
+    av_assert0(channel == conv_params->input_num);
+
     output_operand->dims[0] = operands[input_operand_indexes[0]].dims[0];
     output_operand->dims[1] = height - pad_size * 2;
     output_operand->dims[2] = width - pad_size * 2;
@@ -219,45 +206,43 @@ int ff_dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_opera
         return DNN_ERROR;
     }
     output_operand->data = tmp;
-    thread_common_param.output_data = output_operand->data;
-    thread_common_param.operands = operands;
-    thread_common_param.input_operand_indexes = input_operand_indexes;
-    thread_common_param.output_operand_index = output_operand_index;
-    thread_common_param.parameters = parameters;
-    thread_common_param.ctx = ctx;
 
-#if HAVE_PTHREAD_CANCEL
-    thread_param = av_malloc_array(thread_num, sizeof(*thread_param));
-    if (!thread_param)
+    // partial sums, followed by the im2col rows unless the kernel is 1x1
+    scratch_size = ff_dnn_gemm_scratch_size(conv_params->output_num);
+    if (conv_params->kernel_size > 1)
+        scratch_size += (size_t)DNN_GEMM_MC * filter_size;
+
+    packed = ff_dnn_native_get_buffer(ctx, NATIVE_BUFFER_WEIGHTS,
+                                      ff_dnn_gemm_packed_size(conv_params->output_num, filter_size) * sizeof(float));
+    scratch = ff_dnn_native_get_buffer(ctx, NATIVE_BUFFER_SCRATCH,
+                                       nb_threads * scratch_size * sizeof(float));
+    if (!packed || !scratch) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for conv2d\n");
+        ff_dnn_native_release_buffer(ctx, packed);
+        ff_dnn_native_release_buffer(ctx, scratch);
         return DNN_ERROR;
-    thread_stride = (height - pad_size * 2) / thread_num;
-    //create threads
-    for (int i = 0; i < thread_num; i++){
-        thread_param[i].thread_common_param = &thread_common_param;
-        thread_param[i].thread_start = thread_stride * i + pad_size;
-        thread_param[i].thread_end = (i == thread_num - 1) ? (height - pad_size) : (thread_param[i].thread_start + thread_stride);
-        if (pthread_create(&thread_param[i].thread, NULL,
-                           dnn_execute_layer_conv2d_thread, &thread_param[i])) {
-            thread_num = i;
-            ret = DNN_ERROR;
-            break;
-        }
-    }
-
-    for (int i = 0; i < thread_num; i++){
-        pthread_join(thread_param[i].thread, NULL);
     }
-
-    //release memory
-    av_freep(&thread_param);
-
-    return ret;
-#else
-    thread_param.thread_common_param = &thread_common_param;
-    thread_param.thread_start = pad_size;
-    thread_param.thread_end = height - pad_size;
-    dnn_execute_layer_conv2d_thread(&thread_param);
-
+    ff_dnn_gemm_pack(packed, conv_params->kernel, conv_params->has_bias ? conv_params->biases : NULL,
+                     conv_params->output_num, filter_size);
+
+    job.conv_params   = conv_params;
+    job.input         = operands[input_operand_indexes[0]].data;
+    job.output        = output_operand->data;
+    job.packed        = packed;
+    job.scratch       = scratch;
+    job.scratch_size  = scratch_size;
+    job.fdsp          = ctx ? ctx->fdsp : NULL;
+    job.number        = output_operand->dims[0];
+    job.height        = height;
+    job.width         = width;
+    job.output_height = output_operand->dims[1];
+    job.output_width  = output_operand->dims[2];
+    job.pad_size      = pad_size;
+
+    ff_dnn_native_execute(ctx, dnn_execute_layer_conv2d_job, &job,
+                          FFMIN(job.number * job.output_height, nb_threads));
+
+    ff_dnn_native_release_buffer(ctx, packed);
+    ff_dnn_native_release_buffer(ctx, scratch);
     return DNN_SUCCESS;
-#endif
 }
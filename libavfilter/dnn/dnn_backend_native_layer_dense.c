@@ -20,6 +20,17 @@
 
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_dense.h"
+#include "dnn_backend_native_gemm.h"
+
+typedef struct DenseJob{
+    const DenseParams *dense_params;
+    const float *input;
+    float *output;
+    const float *packed;
+    float *scratch;
+    const AVFloatDSPContext *fdsp;
+    int nb_pixels;
+} DenseJob;
 
 int ff_dnn_load_layer_dense(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
 {
@@ -82,20 +93,36 @@ int ff_dnn_load_layer_dense(Layer *layer, AVIOContext *model_file_context, int f
     return dnn_size;
 }
 
+static void dnn_execute_layer_dense_job(void *arg, int jobnr, int threadnr, int nb_jobs)
+{
+    const DenseJob *job = arg;
+    const DenseParams *dense_params = job->dense_params;
+    int slice_start = (job->nb_pixels *  jobnr     ) / nb_jobs;
+    int slice_end   = (job->nb_pixels * (jobnr + 1)) / nb_jobs;
+    float *scratch  = job->scratch + threadnr * ff_dnn_gemm_scratch_size(dense_params->output_num);
+
+    ff_dnn_gemm(job->output + (size_t)slice_start * dense_params->output_num, dense_params->output_num,
+                job->input + (size_t)slice_start * dense_params->input_num, dense_params->input_num,
+                job->packed, scratch, slice_end - slice_start,
+                dense_params->output_num, dense_params->input_num,
+                dense_params->activation, job->fdsp);
+}
+
 int ff_dnn_execute_layer_dense(DnnOperand *operands, const int32_t *input_operand_indexes,
                                int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
-    float *output;
     int32_t input_operand_index = input_operand_indexes[0];
     int number = operands[input_operand_index].dims[0];
     int height = operands[input_operand_index].dims[1];
     int width = operands[input_operand_index].dims[2];
     int channel = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
     const DenseParams *dense_params = parameters;
-
-    int src_linesize = width * channel;
     DnnOperand *output_operand = &operands[output_operand_index];
+    DenseJob job = { 0 };
+    int nb_threads = ff_dnn_native_nb_threads(ctx);
+    float *packed, *scratch;
+    void *tmp;
+
     output_operand->dims[0] = number;
     output_operand->dims[1] = height;
     output_operand->dims[2] = width;
@@ -106,46 +133,40 @@ int ff_dnn_execute_layer_dense(DnnOperand *operands, const int32_t *input_operan
         av_log(ctx, AV_LOG_ERROR, "The output data length overflow\n");
         return DNN_ERROR;
     }
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data) {
+    tmp = av_realloc(output_operand->data, output_operand->length);
+    if (!tmp) {
         av_log(ctx, AV_LOG_ERROR, "Failed to reallocate memory for output\n");
         return DNN_ERROR;
     }
-    output = output_operand->data;
+    output_operand->data = tmp;
 
     av_assert0(channel == dense_params->input_num);
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            for (int n_filter = 0; n_filter < dense_params->output_num; ++n_filter) {
-                if (dense_params->has_bias)
-                    output[n_filter] = dense_params->biases[n_filter];
-                else
-                    output[n_filter] = 0.f;
-
-                for (int ch = 0; ch < dense_params->input_num; ++ch) {
-                    float input_pel;
-                    input_pel = input[y * src_linesize + x * dense_params->input_num + ch];
-                    output[n_filter] += input_pel * dense_params->kernel[n_filter*dense_params->input_num + ch];
-                }
-                switch (dense_params->activation){
-                case RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0);
-                    break;
-                case TANH:
-                    output[n_filter] = 2.0f  / (1.0f + exp(-2.0f * output[n_filter])) - 1.0f;
-                    break;
-                case SIGMOID:
-                    output[n_filter] = 1.0f / (1.0f + exp(-output[n_filter]));
-                    break;
-                case NONE:
-                    break;
-                case LEAKY_RELU:
-                    output[n_filter] = FFMAX(output[n_filter], 0.0) + 0.2 * FFMIN(output[n_filter], 0.0);
-                }
-            }
-            output += dense_params->output_num;
-        }
+    packed = ff_dnn_native_get_buffer(ctx, NATIVE_BUFFER_WEIGHTS,
+                                      ff_dnn_gemm_packed_size(dense_params->output_num, dense_params->input_num) * sizeof(float));
+    scratch = ff_dnn_native_get_buffer(ctx, NATIVE_BUFFER_SCRATCH,
+                                       nb_threads * ff_dnn_gemm_scratch_size(dense_params->output_num) * sizeof(float));
+    if (!packed || !scratch) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to allocate memory for dense\n");
+        ff_dnn_native_release_buffer(ctx, packed);
+        ff_dnn_native_release_buffer(ctx, scratch);
+        return DNN_ERROR;
     }
+    ff_dnn_gemm_pack(packed, dense_params->kernel, dense_params->has_bias ? dense_params->biases : NULL,
+                     dense_params->output_num, dense_params->input_num);
+
+    job.dense_params = dense_params;
+    job.input        = operands[input_operand_index].data;
+    job.output       = output_operand->data;
+    job.packed       = packed;
+    job.scratch      = scratch;
+    job.fdsp         = ctx ? ctx->fdsp : NULL;
+    job.nb_pixels    = number * height * width;
+
+    ff_dnn_native_execute(ctx, dnn_execute_layer_dense_job, &job,
+                          FFMIN(number * height, nb_threads));
+
+    ff_dnn_native_release_buffer(ctx, packed);
+    ff_dnn_native_release_buffer(ctx, scratch);
     return 0;
 }
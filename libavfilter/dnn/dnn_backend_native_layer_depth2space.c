@@ -85,18 +85,20 @@ int ff_dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_
     }
     output = output_operand->data;
 
-    for (y = 0; y < height; ++y){
-        for (x = 0; x < width; ++x){
-            for (by = 0; by < block_size; ++by){
-                for (bx = 0; bx < block_size; ++bx){
-                    for (ch = 0; ch < new_channels; ++ch){
-                        output[by * by_linesize + x * x_linesize + bx * new_channels + ch] = input[ch];
+    for (int n = 0; n < number; ++n){
+        for (y = 0; y < height; ++y){
+            for (x = 0; x < width; ++x){
+                for (by = 0; by < block_size; ++by){
+                    for (bx = 0; bx < block_size; ++bx){
+                        for (ch = 0; ch < new_channels; ++ch){
+                            output[by * by_linesize + x * x_linesize + bx * new_channels + ch] = input[ch];
+                        }
+                        input += new_channels;
                     }
-                    input += new_channels;
                 }
             }
+            output += output_linesize;
         }
-        output += output_linesize;
     }
     return 0;
 }
@@ -132,6 +132,9 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    void *branch_thread;
+    int (*branch_execute)(AVFilterGraph *graph, AVFilterContext **filters,
+                          int nb_filters);
     FFFrameQueueGlobal frame_queues;
 };
 
@@ -23,10 +23,12 @@
 
 #include <stddef.h>
 
+#include "libavutil/avassert.h"
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -37,12 +39,24 @@ typedef struct ThreadContext {
     AVSliceThread *thread;
     avfilter_action_func *func;
 
+    /* protects busy, set while the slice threads run the jobs of a filter */
+    pthread_mutex_t lock;
+    int busy;
+
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
 } ThreadContext;
 
+typedef struct BranchContext {
+    AVSliceThread *thread;
+
+    /* per-execute parameters */
+    AVFilterContext **filters;
+    int *rets;
+} BranchContext;
+
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
     ThreadContext *c = priv;
@@ -51,9 +65,16 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void branch_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    BranchContext *c = priv;
+    c->rets[jobnr] = ff_filter_activate(c->filters[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    pthread_mutex_destroy(&c->lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -63,23 +84,96 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    pthread_mutex_lock(&c->lock);
+    /* The slice threads are busy with a filter activated concurrently by
+     * branch threading, run the jobs in the calling branch thread instead
+     * of waiting for them. */
+    if (c->busy) {
+        int i;
+
+        pthread_mutex_unlock(&c->lock);
+        for (i = 0; i < nb_jobs; i++) {
+            int r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+    c->busy = 1;
+    pthread_mutex_unlock(&c->lock);
+
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+
+    pthread_mutex_lock(&c->lock);
+    c->busy = 0;
+    pthread_mutex_unlock(&c->lock);
     return 0;
 }
 
+static int branch_execute(AVFilterGraph *graph, AVFilterContext **filters,
+                          int nb_filters)
+{
+    BranchContext *c = graph->internal->branch_thread;
+    int rets[MAX_BRANCHES];
+    int i, ret = 0;
+
+    av_assert1(nb_filters <= MAX_BRANCHES);
+    c->filters = filters;
+    c->rets    = rets;
+
+    avpriv_slicethread_execute(c->thread, nb_filters, 0);
+
+    for (i = 0; i < nb_filters; i++)
+        if (rets[i] < 0 && !ret)
+            ret = rets[i];
+    return ret;
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
+    int ret = pthread_mutex_init(&c->lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
+        pthread_mutex_destroy(&c->lock);
+    } else
+        avpriv_slicethread_set_priority(c->thread, AVPRIV_SLICETHREAD_PRIORITY_FILTER);
     return FFMAX(nb_threads, 1);
 }
 
+static int branch_thread_init(AVFilterGraph *graph)
+{
+    BranchContext *c;
+    int ret;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    ret = avpriv_slicethread_create(&c->thread, c, branch_worker_func, NULL,
+                                    FFMIN(graph->nb_threads, MAX_BRANCHES));
+    if (ret <= 1) {
+        avpriv_slicethread_free(&c->thread);
+        av_free(c);
+        return ret < 0 ? ret : 0;
+    }
+    avpriv_slicethread_set_priority(c->thread, AVPRIV_SLICETHREAD_PRIORITY_FILTER);
+
+    graph->internal->branch_thread  = c;
+    graph->internal->branch_execute = branch_execute;
+
+    return 0;
+}
+
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
     int ret;
@@ -104,11 +198,24 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_BRANCH) {
+        ret = branch_thread_init(graph);
+        if (ret < 0)
+            return ret;
+    }
+
     return 0;
 }
 
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
+    BranchContext *branch = graph->internal->branch_thread;
+
+    if (branch)
+        avpriv_slicethread_free(&branch->thread);
+    av_freep(&graph->internal->branch_thread);
+    graph->internal->branch_execute = NULL;
+
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
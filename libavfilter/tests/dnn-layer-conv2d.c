@@ -96,8 +96,7 @@ static int test_with_same_dilate(void)
     };
     float bias[2] = { -1.6574852, -0.72915393 };
 
-    NativeContext ctx;
-    ctx.class = NULL;
+    NativeContext ctx = { 0 };
     ctx.options.conv2d_threads = 1;
 
     params.activation = TANH;
@@ -125,11 +124,13 @@ static int test_with_same_dilate(void)
         if (fabs(output[i] - expected_output[i]) > EPSON) {
             printf("at index %d, output: %f, expected_output: %f\n", i, output[i], expected_output[i]);
             av_freep(&output);
+            ff_dnn_native_uninit_context(&ctx);
             return 1;
         }
     }
 
     av_freep(&output);
+    ff_dnn_native_uninit_context(&ctx);
     return 0;
 }
 
@@ -200,9 +201,10 @@ static int test_with_valid(void)
     };
     float bias[2] = { -0.4773722, -0.19620377 };
 
-    NativeContext ctx;
-    ctx.class = NULL;
-    ctx.options.conv2d_threads = 1;
+    NativeContext ctx = { 0 };
+    ctx.options.conv2d_threads = 2;
+    if (ff_dnn_native_init_context(&ctx) < 0)
+        return 1;
 
     params.activation = TANH;
     params.has_bias = 1;
@@ -229,11 +231,13 @@ static int test_with_valid(void)
         if (fabs(output[i] - expected_output[i]) > EPSON) {
             printf("at index %d, output: %f, expected_output: %f\n", i, output[i], expected_output[i]);
             av_freep(&output);
+            ff_dnn_native_uninit_context(&ctx);
             return 1;
         }
     }
 
     av_freep(&output);
+    ff_dnn_native_uninit_context(&ctx);
     return 0;
 }
 
@@ -21,6 +21,11 @@
 
 #include "avfilter.h"
 
+/**
+ * Maximum number of filters activated at once with AVFILTER_THREAD_BRANCH.
+ */
+#define MAX_BRANCHES 64
+
 int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
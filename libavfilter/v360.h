@@ -111,6 +111,8 @@ typedef struct XYRemap {
     float ker[4][4];
 } XYRemap;
 
+typedef struct V360Maps V360Maps;
+
 typedef struct SliceXYRemap {
     int16_t *u[2], *v[2];
     int16_t *ker[2];
@@ -175,6 +177,8 @@ typedef struct V360Context {
     int max_value;
     int nb_threads;
 
+    char *map_file;
+    V360Maps *maps;
     SliceXYRemap *slice_remap;
     unsigned map[4];
 
@@ -48,18 +48,34 @@ typedef struct NLMeansContext {
     int patch_size_uv, patch_hsize_uv;          // patch size and half size for chroma planes
     int research_size,    research_hsize;       // research size and half size
     int research_size_uv, research_hsize_uv;    // research size and half size for chroma planes
-    uint32_t *ii_orig;                          // integral image
-    uint32_t *ii;                               // integral image starting after the 0-line and 0-column
-    int ii_w, ii_h;                             // width and height of the integral image
-    ptrdiff_t ii_lz_32;                         // linesize in 32-bit units of the integral image
+    int depth;                                  // bit depth of the input
+    int shift;                                  // squared differences right shift to bring them to the 8-bit scale
+    uint32_t **ii_orig;                         // integral image of a tile, one for every job
+    int nb_jobs;                                // number of integral images
+    ptrdiff_t ii_lz_32;                         // linesize in 32-bit units of the integral images
     float *total_weight;                        // total weight for every pixel
     float *sum;                                 // weighted sum for every pixel
     int linesize;                               // sum and total_weight linesize
     float *weight_lut;                          // lookup table mapping (scaled) patch differences to their associated weights
     uint32_t max_meaningful_diff;               // maximum difference considered (if the patch difference is too high we ignore the pixel)
     NLMeansDSPContext dsp;
+    int (*filter_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 } NLMeansContext;
 
+typedef struct ThreadData {
+    uint8_t *dst;
+    ptrdiff_t dst_linesize;
+    const uint8_t *src;
+    ptrdiff_t src_linesize;
+    int w, h;
+    int p, r;
+} ThreadData;
+
+/* size of the tiles a slice is split into, a tile is processed with all the
+ * offsets of the research window while its integral image stays in cache */
+#define NLMEANS_TILE_W 128
+#define NLMEANS_TILE_H 64
+
 #define OFFSET(x) offsetof(NLMeansContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 static const AVOption nlmeans_options[] = {
@@ -81,231 +97,75 @@ static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ420P,
     AV_PIX_FMT_YUVJ411P,
     AV_PIX_FMT_GRAY8, AV_PIX_FMT_GBRP,
+    AV_PIX_FMT_YUV420P9, AV_PIX_FMT_YUV422P9, AV_PIX_FMT_YUV444P9,
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV440P10, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV440P12, AV_PIX_FMT_YUV444P12,
+    AV_PIX_FMT_YUV420P14, AV_PIX_FMT_YUV422P14, AV_PIX_FMT_YUV444P14,
+    AV_PIX_FMT_YUV420P16, AV_PIX_FMT_YUV422P16, AV_PIX_FMT_YUV444P16,
+    AV_PIX_FMT_GRAY9, AV_PIX_FMT_GRAY10, AV_PIX_FMT_GRAY12, AV_PIX_FMT_GRAY14, AV_PIX_FMT_GRAY16,
+    AV_PIX_FMT_GBRP9, AV_PIX_FMT_GBRP10, AV_PIX_FMT_GBRP12, AV_PIX_FMT_GBRP14, AV_PIX_FMT_GBRP16,
     AV_PIX_FMT_NONE
 };
 
-/**
- * Compute squared difference of the safe area (the zone where s1 and s2
- * overlap). It is likely the largest integral zone, so it is interesting to do
- * as little checks as possible; contrary to the unsafe version of this
- * function, we do not need any clipping here.
- *
- * The line above dst and the column to its left are always readable.
- */
-static void compute_safe_ssd_integral_image_c(uint32_t *dst, ptrdiff_t dst_linesize_32,
-                                              const uint8_t *s1, ptrdiff_t linesize1,
-                                              const uint8_t *s2, ptrdiff_t linesize2,
-                                              int w, int h)
-{
-    const uint32_t *dst_top = dst - dst_linesize_32;
-
-    /* SIMD-friendly assumptions allowed here */
-    av_assert2(!(w & 0xf) && w >= 16 && h >= 1);
-
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x += 4) {
-            const int d0 = s1[x    ] - s2[x    ];
-            const int d1 = s1[x + 1] - s2[x + 1];
-            const int d2 = s1[x + 2] - s2[x + 2];
-            const int d3 = s1[x + 3] - s2[x + 3];
-
-            dst[x    ] = dst_top[x    ] - dst_top[x - 1] + d0*d0;
-            dst[x + 1] = dst_top[x + 1] - dst_top[x    ] + d1*d1;
-            dst[x + 2] = dst_top[x + 2] - dst_top[x + 1] + d2*d2;
-            dst[x + 3] = dst_top[x + 3] - dst_top[x + 2] + d3*d3;
-
-            dst[x    ] += dst[x - 1];
-            dst[x + 1] += dst[x    ];
-            dst[x + 2] += dst[x + 1];
-            dst[x + 3] += dst[x + 2];
-        }
-        s1  += linesize1;
-        s2  += linesize2;
-        dst += dst_linesize_32;
-        dst_top += dst_linesize_32;
-    }
-}
+#define DEPTH 8
+#include "vf_nlmeans_template.c"
 
-/**
- * Compute squared difference of an unsafe area (the zone nor s1 nor s2 could
- * be readable).
- *
- * On the other hand, the line above dst and the column to its left are always
- * readable.
- *
- * There is little point in having this function SIMDified as it is likely too
- * complex and only handle small portions of the image.
- *
- * @param dst               integral image
- * @param dst_linesize_32   integral image linesize (in 32-bit integers unit)
- * @param startx            integral starting x position
- * @param starty            integral starting y position
- * @param src               source plane buffer
- * @param linesize          source plane linesize
- * @param offx              source offsetting in x
- * @param offy              source offsetting in y
- * @paran r                 absolute maximum source offsetting
- * @param sw                source width
- * @param sh                source height
- * @param w                 width to compute
- * @param h                 height to compute
- */
-static inline void compute_unsafe_ssd_integral_image(uint32_t *dst, ptrdiff_t dst_linesize_32,
-                                                     int startx, int starty,
-                                                     const uint8_t *src, ptrdiff_t linesize,
-                                                     int offx, int offy, int r, int sw, int sh,
-                                                     int w, int h)
-{
-    for (int y = starty; y < starty + h; y++) {
-        uint32_t acc = dst[y*dst_linesize_32 + startx - 1] - dst[(y-1)*dst_linesize_32 + startx - 1];
-        const int s1y = av_clip(y -  r,         0, sh - 1);
-        const int s2y = av_clip(y - (r + offy), 0, sh - 1);
-
-        for (int x = startx; x < startx + w; x++) {
-            const int s1x = av_clip(x -  r,         0, sw - 1);
-            const int s2x = av_clip(x - (r + offx), 0, sw - 1);
-            const uint8_t v1 = src[s1y*linesize + s1x];
-            const uint8_t v2 = src[s2y*linesize + s2x];
-            const int d = v1 - v2;
-            acc += d * d;
-            dst[y*dst_linesize_32 + x] = dst[(y-1)*dst_linesize_32 + x] + acc;
-        }
-    }
-}
-
-/*
- * Compute the sum of squared difference integral image
- * http://www.ipol.im/pub/art/2014/57/
- * Integral Images for Block Matching - Gabriele Facciolo, Nicolas Limare, Enric Meinhardt-Llopis
- *
- * @param ii                integral image of dimension (w+e*2) x (h+e*2) with
- *                          an additional zeroed top line and column already
- *                          "applied" to the pointer value
- * @param ii_linesize_32    integral image linesize (in 32-bit integers unit)
- * @param src               source plane buffer
- * @param linesize          source plane linesize
- * @param offx              x-offsetting ranging in [-e;e]
- * @param offy              y-offsetting ranging in [-e;e]
- * @param w                 source width
- * @param h                 source height
- * @param e                 research padding edge
- */
-static void compute_ssd_integral_image(const NLMeansDSPContext *dsp,
-                                       uint32_t *ii, ptrdiff_t ii_linesize_32,
-                                       const uint8_t *src, ptrdiff_t linesize, int offx, int offy,
-                                       int e, int w, int h)
-{
-    // ii has a surrounding padding of thickness "e"
-    const int ii_w = w + e*2;
-    const int ii_h = h + e*2;
-
-    // we center the first source
-    const int s1x = e;
-    const int s1y = e;
-
-    // 2nd source is the frame with offsetting
-    const int s2x = e + offx;
-    const int s2y = e + offy;
-
-    // get the dimension of the overlapping rectangle where it is always safe
-    // to compare the 2 sources pixels
-    const int startx_safe = FFMAX(s1x, s2x);
-    const int starty_safe = FFMAX(s1y, s2y);
-    const int u_endx_safe = FFMIN(s1x + w, s2x + w); // unaligned
-    const int endy_safe   = FFMIN(s1y + h, s2y + h);
-
-    // deduce the safe area width and height
-    const int safe_pw = (u_endx_safe - startx_safe) & ~0xf;
-    const int safe_ph = endy_safe - starty_safe;
-
-    // adjusted end x position of the safe area after width of the safe area gets aligned
-    const int endx_safe = startx_safe + safe_pw;
-
-    // top part where only one of s1 and s2 is still readable, or none at all
-    compute_unsafe_ssd_integral_image(ii, ii_linesize_32,
-                                      0, 0,
-                                      src, linesize,
-                                      offx, offy, e, w, h,
-                                      ii_w, starty_safe);
-
-    // fill the left column integral required to compute the central
-    // overlapping one
-    compute_unsafe_ssd_integral_image(ii, ii_linesize_32,
-                                      0, starty_safe,
-                                      src, linesize,
-                                      offx, offy, e, w, h,
-                                      startx_safe, safe_ph);
-
-    // main and safe part of the integral
-    av_assert1(startx_safe - s1x >= 0); av_assert1(startx_safe - s1x < w);
-    av_assert1(starty_safe - s1y >= 0); av_assert1(starty_safe - s1y < h);
-    av_assert1(startx_safe - s2x >= 0); av_assert1(startx_safe - s2x < w);
-    av_assert1(starty_safe - s2y >= 0); av_assert1(starty_safe - s2y < h);
-    if (safe_pw && safe_ph)
-        dsp->compute_safe_ssd_integral_image(ii + starty_safe*ii_linesize_32 + startx_safe, ii_linesize_32,
-                                             src + (starty_safe - s1y) * linesize + (startx_safe - s1x), linesize,
-                                             src + (starty_safe - s2y) * linesize + (startx_safe - s2x), linesize,
-                                             safe_pw, safe_ph);
-
-    // right part of the integral
-    compute_unsafe_ssd_integral_image(ii, ii_linesize_32,
-                                      endx_safe, starty_safe,
-                                      src, linesize,
-                                      offx, offy, e, w, h,
-                                      ii_w - endx_safe, safe_ph);
-
-    // bottom part where only one of s1 and s2 is still readable, or none at all
-    compute_unsafe_ssd_integral_image(ii, ii_linesize_32,
-                                      0, endy_safe,
-                                      src, linesize,
-                                      offx, offy, e, w, h,
-                                      ii_w, ii_h - endy_safe);
-}
+#undef DEPTH
+#define DEPTH 16
+#include "vf_nlmeans_template.c"
 
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     NLMeansContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
-    const int e = FFMAX(s->research_hsize, s->research_hsize_uv)
-                + FFMAX(s->patch_hsize,    s->patch_hsize_uv);
+    const int p = FFMAX(s->patch_hsize, s->patch_hsize_uv);
 
     s->chroma_w = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
     s->chroma_h = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->nb_planes = av_pix_fmt_count_planes(inlink->format);
 
-    /* Allocate the integral image with extra edges of thickness "e"
+    s->depth = desc->comp[0].depth;
+    s->shift = 2 * (s->depth - 8);
+    s->filter_slice = s->depth > 8 ? nlmeans_slice_16 : nlmeans_slice_8;
+
+    /* Allocate an integral image per job, covering a tile extended by the
+     * patch half size p on each side
      *
      *   +_+-------------------------------+
      *   |0|0000000000000000000000000000000|
      *   +-x-------------------------------+
      *   |0|\    ^                         |
-     *   |0| ii  | e                       |
+     *   |0| ii  | p                       |
      *   |0|     v                         |
      *   |0|   +-----------------------+   |
      *   |0|   |                       |   |
-     *   |0|<->|                       |   |
-     *   |0| e |                       |   |
+     *   |0|<->|         tile          |   |
+     *   |0| p |                       |   |
      *   |0|   |                       |   |
      *   |0|   +-----------------------+   |
      *   |0|                               |
      *   |0|                               |
-     *   |0|                               |
      *   +-+-------------------------------+
      */
-    s->ii_w = inlink->w + e*2;
-    s->ii_h = inlink->h + e*2;
 
     // align to 4 the linesize, "+1" is for the space of the left 0-column
-    s->ii_lz_32 = FFALIGN(s->ii_w + 1, 4);
+    s->ii_lz_32 = FFALIGN(NLMEANS_TILE_W + 2*p + 1, 4);
 
-    // "+1" is for the space of the top 0-line
-    s->ii_orig = av_calloc(s->ii_h + 1, s->ii_lz_32 * sizeof(*s->ii_orig));
+    for (int i = 0; i < s->nb_jobs && s->ii_orig; i++)
+        av_freep(&s->ii_orig[i]);
+    av_freep(&s->ii_orig);
+    s->nb_jobs = ff_filter_get_nb_threads(ctx);
+    s->ii_orig = av_calloc(s->nb_jobs, sizeof(*s->ii_orig));
     if (!s->ii_orig)
         return AVERROR(ENOMEM);
-
-    // skip top 0-line and left 0-column
-    s->ii = s->ii_orig + s->ii_lz_32 + 1;
+    for (int i = 0; i < s->nb_jobs; i++) {
+        // "+1" is for the space of the top 0-line, another line is left for
+        // the overreads of the SIMD past the end of the last line
+        s->ii_orig[i] = av_calloc(NLMEANS_TILE_H + 2*p + 2, s->ii_lz_32 * sizeof(*s->ii_orig[i]));
+        if (!s->ii_orig[i])
+            return AVERROR(ENOMEM);
+    }
 
     // allocate weighted average for every pixel
     s->linesize = inlink->w + 100;
@@ -317,162 +177,23 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
-struct thread_data {
-    const uint8_t *src;
-    ptrdiff_t src_linesize;
-    int startx, starty;
-    int endx, endy;
-    const uint32_t *ii_start;
-    int p;
-};
-
-static void compute_weights_line_c(const uint32_t *const iia,
-                                   const uint32_t *const iib,
-                                   const uint32_t *const iid,
-                                   const uint32_t *const iie,
-                                   const uint8_t *const src,
-                                   float *total_weight,
-                                   float *sum,
-                                   const float *const weight_lut,
-                                   int max_meaningful_diff,
-                                   int startx, int endx)
-{
-    for (int x = startx; x < endx; x++) {
-        /*
-         * M is a discrete map where every entry contains the sum of all the entries
-         * in the rectangle from the top-left origin of M to its coordinate. In the
-         * following schema, "i" contains the sum of the whole map:
-         *
-         * M = +----------+-----------------+----+
-         *     |          |                 |    |
-         *     |          |                 |    |
-         *     |         a|                b|   c|
-         *     +----------+-----------------+----+
-         *     |          |                 |    |
-         *     |          |                 |    |
-         *     |          |        X        |    |
-         *     |          |                 |    |
-         *     |         d|                e|   f|
-         *     +----------+-----------------+----+
-         *     |          |                 |    |
-         *     |         g|                h|   i|
-         *     +----------+-----------------+----+
-         *
-         * The sum of the X box can be calculated with:
-         *    X = e-d-b+a
-         *
-         * See https://en.wikipedia.org/wiki/Summed_area_table
-         *
-         * The compute*_ssd functions compute the integral image M where every entry
-         * contains the sum of the squared difference of every corresponding pixels of
-         * two input planes of the same size as M.
-         */
-        const uint32_t a = iia[x];
-        const uint32_t b = iib[x];
-        const uint32_t d = iid[x];
-        const uint32_t e = iie[x];
-        const uint32_t patch_diff_sq = FFMIN(e - d - b + a, max_meaningful_diff);
-        const float weight = weight_lut[patch_diff_sq]; // exp(-patch_diff_sq * s->pdiff_scale)
-
-        total_weight[x] += weight;
-        sum[x] += weight * src[x];
-    }
-}
-
-static int nlmeans_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
-{
-    NLMeansContext *s = ctx->priv;
-    const uint32_t max_meaningful_diff = s->max_meaningful_diff;
-    const struct thread_data *td = arg;
-    const ptrdiff_t src_linesize = td->src_linesize;
-    const int process_h = td->endy - td->starty;
-    const int slice_start = (process_h *  jobnr   ) / nb_jobs;
-    const int slice_end   = (process_h * (jobnr+1)) / nb_jobs;
-    const int starty = td->starty + slice_start;
-    const int endy   = td->starty + slice_end;
-    const int p = td->p;
-    const uint32_t *ii = td->ii_start + (starty - p - 1) * s->ii_lz_32 - p - 1;
-    const int dist_b = 2*p + 1;
-    const int dist_d = dist_b * s->ii_lz_32;
-    const int dist_e = dist_d + dist_b;
-    const float *const weight_lut = s->weight_lut;
-    NLMeansDSPContext *dsp = &s->dsp;
-
-    for (int y = starty; y < endy; y++) {
-        const uint8_t *const src = td->src + y*src_linesize;
-        float *total_weight = s->total_weight + y*s->linesize;
-        float *sum = s->sum + y*s->linesize;
-        const uint32_t *const iia = ii;
-        const uint32_t *const iib = ii + dist_b;
-        const uint32_t *const iid = ii + dist_d;
-        const uint32_t *const iie = ii + dist_e;
-
-        dsp->compute_weights_line(iia, iib, iid, iie, src, total_weight, sum,
-                                  weight_lut, max_meaningful_diff,
-                                  td->startx, td->endx);
-        ii += s->ii_lz_32;
-    }
-    return 0;
-}
-
-static void weight_averages(uint8_t *dst, ptrdiff_t dst_linesize,
-                            const uint8_t *src, ptrdiff_t src_linesize,
-                            float *total_weight, float *sum, ptrdiff_t linesize,
-                            int w, int h)
-{
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
-            // Also weight the centered pixel
-            total_weight[x] += 1.f;
-            sum[x] += 1.f * src[x];
-            dst[x] = av_clip_uint8(sum[x] / total_weight[x] + 0.5f);
-        }
-        dst += dst_linesize;
-        src += src_linesize;
-        total_weight += linesize;
-        sum += linesize;
-    }
-}
-
 static int nlmeans_plane(AVFilterContext *ctx, int w, int h, int p, int r,
                          uint8_t *dst, ptrdiff_t dst_linesize,
                          const uint8_t *src, ptrdiff_t src_linesize)
 {
     NLMeansContext *s = ctx->priv;
-    /* patches center points cover the whole research window so the patches
-     * themselves overflow the research window */
-    const int e = r + p;
-    /* focus an integral pointer on the centered image (s1) */
-    const uint32_t *centered_ii = s->ii + e*s->ii_lz_32 + e;
-
-    memset(s->total_weight, 0, s->linesize * h * sizeof(*s->total_weight));
-    memset(s->sum, 0, s->linesize * h * sizeof(*s->sum));
-
-    for (int offy = -r; offy <= r; offy++) {
-        for (int offx = -r; offx <= r; offx++) {
-            if (offx || offy) {
-                struct thread_data td = {
-                    .src          = src + offy*src_linesize + offx,
-                    .src_linesize = src_linesize,
-                    .startx       = FFMAX(0, -offx),
-                    .starty       = FFMAX(0, -offy),
-                    .endx         = FFMIN(w, w - offx),
-                    .endy         = FFMIN(h, h - offy),
-                    .ii_start     = centered_ii + offy*s->ii_lz_32 + offx,
-                    .p            = p,
-                };
-
-                compute_ssd_integral_image(&s->dsp, s->ii, s->ii_lz_32,
-                                           src, src_linesize,
-                                           offx, offy, e, w, h);
-                ff_filter_execute(ctx, nlmeans_slice, &td, NULL,
-                                  FFMIN(td.endy - td.starty, ff_filter_get_nb_threads(ctx)));
-            }
-        }
-    }
-
-    weight_averages(dst, dst_linesize, src, src_linesize,
-                    s->total_weight, s->sum, s->linesize, w, h);
+    ThreadData td = {
+        .dst          = dst,
+        .dst_linesize = dst_linesize,
+        .src          = src,
+        .src_linesize = src_linesize,
+        .w            = w,
+        .h            = h,
+        .p            = p,
+        .r            = r,
+    };
+
+    ff_filter_execute(ctx, s->filter_slice, &td, NULL, FFMIN(h, s->nb_jobs));
 
     return 0;
 }
@@ -514,8 +235,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 
 void ff_nlmeans_init(NLMeansDSPContext *dsp)
 {
-    dsp->compute_safe_ssd_integral_image = compute_safe_ssd_integral_image_c;
-    dsp->compute_weights_line = compute_weights_line_c;
+    dsp->compute_safe_ssd_integral_image = compute_safe_ssd_integral_image_c_8;
+    dsp->compute_weights_line = compute_weights_line_c_8;
+    dsp->compute_safe_ssd_integral_image16 = compute_safe_ssd_integral_image_c_16;
+    dsp->compute_weights_line16 = compute_weights_line_c_16;
 
     if (ARCH_AARCH64)
         ff_nlmeans_init_aarch64(dsp);
@@ -564,6 +287,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     NLMeansContext *s = ctx->priv;
     av_freep(&s->weight_lut);
+    for (int i = 0; i < s->nb_jobs && s->ii_orig; i++)
+        av_freep(&s->ii_orig[i]);
     av_freep(&s->ii_orig);
     av_freep(&s->total_weight);
     av_freep(&s->sum);
@@ -37,6 +37,25 @@ typedef struct NLMeansDSPContext {
                                  const float *const weight_lut,
                                  int max_meaningful_diff,
                                  int startx, int endx);
+    /**
+     * Versions of the above for input with more than 8 bits per component.
+     * Linesizes are in 16-bit units, squared differences are shifted right
+     * by shift bits with rounding to bring them to the 8-bit scale.
+     */
+    void (*compute_safe_ssd_integral_image16)(uint32_t *dst, ptrdiff_t dst_linesize_32,
+                                              const uint16_t *s1, ptrdiff_t linesize1,
+                                              const uint16_t *s2, ptrdiff_t linesize2,
+                                              int w, int h, int shift);
+    void (*compute_weights_line16)(const uint32_t *const iia,
+                                   const uint32_t *const iib,
+                                   const uint32_t *const iid,
+                                   const uint32_t *const iie,
+                                   const uint16_t *const src,
+                                   float *total_weight,
+                                   float *sum,
+                                   const float *const weight_lut,
+                                   int max_meaningful_diff,
+                                   int startx, int endx);
 } NLMeansDSPContext;
 
 void ff_nlmeans_init(NLMeansDSPContext *dsp);
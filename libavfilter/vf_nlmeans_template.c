@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2016 Clément Bœsch <u pkh me>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#undef pixel
+#undef SQR_DIFF
+#undef DSP_SUFFIX
+#undef SHIFT_ARG
+#if DEPTH == 8
+#define pixel uint8_t
+#define SQR_DIFF(a, b) (((a) - (b)) * ((a) - (b)))
+#define DSP_SUFFIX
+#define SHIFT_ARG
+#else
+#define pixel uint16_t
+/* squared difference brought to the 8-bit scale, it may not fit in an int */
+#define SQR_DIFF(a, b) (((uint32_t)((a) - (b)) * ((a) - (b)) + (1U << (shift - 1))) >> shift)
+#define DSP_SUFFIX 16
+#define SHIFT_ARG , shift
+#endif
+
+#undef fn
+#undef fn2
+#undef fn3
+#undef dspfn
+#undef dspfn2
+#undef dspfn3
+#define fn3(a,b)   a##_##b
+#define fn2(a,b)   fn3(a,b)
+#define fn(a)      fn2(a, DEPTH)
+#define dspfn3(a,b) a##b
+#define dspfn2(a,b) dspfn3(a,b)
+#define dspfn(a)   dspfn2(a, DSP_SUFFIX)
+
+/**
+ * Compute squared difference of the safe area (the zone where s1 and s2
+ * overlap). It is likely the largest integral zone, so it is interesting to do
+ * as little checks as possible; contrary to the unsafe version of this
+ * function, we do not need any clipping here.
+ *
+ * The line above dst and the column to its left are always readable.
+ */
+static void fn(compute_safe_ssd_integral_image_c)(uint32_t *dst, ptrdiff_t dst_linesize_32,
+                                                  const pixel *s1, ptrdiff_t linesize1,
+                                                  const pixel *s2, ptrdiff_t linesize2,
+#if DEPTH == 8
+                                                  int w, int h)
+#else
+                                                  int w, int h, int shift)
+#endif
+{
+    const uint32_t *dst_top = dst - dst_linesize_32;
+
+    /* SIMD-friendly assumptions allowed here */
+    av_assert2(!(w & 0xf) && w >= 16 && h >= 1);
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x += 4) {
+            dst[x    ] = dst_top[x    ] - dst_top[x - 1] + SQR_DIFF(s1[x    ], s2[x    ]);
+            dst[x + 1] = dst_top[x + 1] - dst_top[x    ] + SQR_DIFF(s1[x + 1], s2[x + 1]);
+            dst[x + 2] = dst_top[x + 2] - dst_top[x + 1] + SQR_DIFF(s1[x + 2], s2[x + 2]);
+            dst[x + 3] = dst_top[x + 3] - dst_top[x + 2] + SQR_DIFF(s1[x + 3], s2[x + 3]);
+
+            dst[x    ] += dst[x - 1];
+            dst[x + 1] += dst[x    ];
+            dst[x + 2] += dst[x + 1];
+            dst[x + 3] += dst[x + 2];
+        }
+        s1  += linesize1;
+        s2  += linesize2;
+        dst += dst_linesize_32;
+        dst_top += dst_linesize_32;
+    }
+}
+
+/**
+ * Compute squared difference of an unsafe area (the zone nor s1 nor s2 could
+ * be readable).
+ *
+ * On the other hand, the line above dst and the column to its left are always
+ * readable.
+ *
+ * There is little point in having this function SIMDified as it is likely too
+ * complex and only handle small portions of the image.
+ *
+ * @param dst               integral image
+ * @param dst_linesize_32   integral image linesize (in 32-bit integers unit)
+ * @param startx            integral starting x position
+ * @param starty            integral starting y position
+ * @param src               source plane buffer
+ * @param linesize          source plane linesize (in pixels)
+ * @param offx              source offsetting in x
+ * @param offy              source offsetting in y
+ * @param orgx              source x position of the integral x position 0
+ * @param orgy              source y position of the integral y position 0
+ * @param sw                source width
+ * @param sh                source height
+ * @param w                 width to compute
+ * @param h                 height to compute
+ */
+static inline void fn(compute_unsafe_ssd_integral_image)(uint32_t *dst, ptrdiff_t dst_linesize_32,
+                                                         int startx, int starty,
+                                                         const pixel *src, ptrdiff_t linesize,
+                                                         int offx, int offy, int orgx, int orgy,
+                                                         int sw, int sh, int w, int h, int shift)
+{
+    for (int y = starty; y < starty + h; y++) {
+        uint32_t acc = dst[y*dst_linesize_32 + startx - 1] - dst[(y-1)*dst_linesize_32 + startx - 1];
+        const int s1y = av_clip(orgy + y + offy, 0, sh - 1);
+        const int s2y = av_clip(orgy + y,        0, sh - 1);
+
+        for (int x = startx; x < startx + w; x++) {
+            const int s1x = av_clip(orgx + x + offx, 0, sw - 1);
+            const int s2x = av_clip(orgx + x,        0, sw - 1);
+            const int v1 = src[s1y*linesize + s1x];
+            const int v2 = src[s2y*linesize + s2x];
+            acc += SQR_DIFF(v1, v2);
+            dst[y*dst_linesize_32 + x] = dst[(y-1)*dst_linesize_32 + x] + acc;
+        }
+    }
+}
+
+/*
+ * Compute the sum of squared difference integral image of a tile
+ * http://www.ipol.im/pub/art/2014/57/
+ * Integral Images for Block Matching - Gabriele Facciolo, Nicolas Limare, Enric Meinhardt-Llopis
+ *
+ * Entry (x, y) of the integral image accumulates the squared differences
+ * between the source pixels (orgx + x, orgy + y) and
+ * (orgx + x + offx, orgy + y + offy), clipped to the plane.
+ *
+ * @param ii                integral image of dimension iw x ih with an
+ *                          additional zeroed top line and column already
+ *                          "applied" to the pointer value
+ * @param ii_linesize_32    integral image linesize (in 32-bit integers unit)
+ * @param src               source plane buffer
+ * @param linesize          source plane linesize (in pixels)
+ * @param offx              x-offsetting of the compared pixels
+ * @param offy              y-offsetting of the compared pixels
+ * @param orgx              source x position of the top-left integral entry
+ * @param orgy              source y position of the top-left integral entry
+ * @param iw                integral image width
+ * @param ih                integral image height
+ * @param w                 source width
+ * @param h                 source height
+ */
+static void fn(compute_ssd_integral_image)(const NLMeansDSPContext *dsp,
+                                           uint32_t *ii, ptrdiff_t ii_linesize_32,
+                                           const pixel *src, ptrdiff_t linesize,
+                                           int offx, int offy, int orgx, int orgy,
+                                           int iw, int ih, int w, int h, int shift)
+{
+    // get the dimension of the rectangle where it is always safe to compare
+    // the 2 sources pixels
+    const int startx_safe = av_clip(FFMAX(0, -offx) - orgx, 0, iw);
+    const int starty_safe = av_clip(FFMAX(0, -offy) - orgy, 0, ih);
+    const int u_endx_safe = av_clip(FFMIN(w, w - offx) - orgx, startx_safe, iw); // unaligned
+    const int endy_safe   = av_clip(FFMIN(h, h - offy) - orgy, starty_safe, ih);
+
+    // deduce the safe area width and height
+    const int safe_pw = (u_endx_safe - startx_safe) & ~0xf;
+    const int safe_ph = endy_safe - starty_safe;
+
+    // adjusted end x position of the safe area after width of the safe area gets aligned
+    const int endx_safe = startx_safe + safe_pw;
+
+    // top part where only one of s1 and s2 is still readable, or none at all
+    fn(compute_unsafe_ssd_integral_image)(ii, ii_linesize_32,
+                                          0, 0,
+                                          src, linesize,
+                                          offx, offy, orgx, orgy, w, h,
+                                          iw, starty_safe, shift);
+
+    // fill the left column integral required to compute the central
+    // overlapping one
+    fn(compute_unsafe_ssd_integral_image)(ii, ii_linesize_32,
+                                          0, starty_safe,
+                                          src, linesize,
+                                          offx, offy, orgx, orgy, w, h,
+                                          startx_safe, safe_ph, shift);
+
+    // main and safe part of the integral
+    if (safe_pw && safe_ph) {
+        const pixel *s2 = src + (orgy + starty_safe) * linesize + orgx + startx_safe;
+        const pixel *s1 = s2 + offy * linesize + offx;
+        dsp->dspfn(compute_safe_ssd_integral_image)(ii + starty_safe*ii_linesize_32 + startx_safe, ii_linesize_32,
+                                                    s1, linesize, s2, linesize,
+                                                    safe_pw, safe_ph SHIFT_ARG);
+    }
+
+    // right part of the integral
+    fn(compute_unsafe_ssd_integral_image)(ii, ii_linesize_32,
+                                          endx_safe, starty_safe,
+                                          src, linesize,
+                                          offx, offy, orgx, orgy, w, h,
+                                          iw - endx_safe, safe_ph, shift);
+
+    // bottom part where only one of s1 and s2 is still readable, or none at all
+    fn(compute_unsafe_ssd_integral_image)(ii, ii_linesize_32,
+                                          0, endy_safe,
+                                          src, linesize,
+                                          offx, offy, orgx, orgy, w, h,
+                                          iw, ih - endy_safe, shift);
+}
+
+static void fn(compute_weights_line_c)(const uint32_t *const iia,
+                                       const uint32_t *const iib,
+                                       const uint32_t *const iid,
+                                       const uint32_t *const iie,
+                                       const pixel *const src,
+                                       float *total_weight,
+                                       float *sum,
+                                       const float *const weight_lut,
+                                       int max_meaningful_diff,
+                                       int startx, int endx)
+{
+    for (int x = startx; x < endx; x++) {
+        /*
+         * M is a discrete map where every entry contains the sum of all the entries
+         * in the rectangle from the top-left origin of M to its coordinate. In the
+         * following schema, "i" contains the sum of the whole map:
+         *
+         * M = +----------+-----------------+----+
+         *     |          |                 |    |
+         *     |          |                 |    |
+         *     |         a|                b|   c|
+         *     +----------+-----------------+----+
+         *     |          |                 |    |
+         *     |          |                 |    |
+         *     |          |        X        |    |
+         *     |          |                 |    |
+         *     |         d|                e|   f|
+         *     +----------+-----------------+----+
+         *     |          |                 |    |
+         *     |         g|                h|   i|
+         *     +----------+-----------------+----+
+         *
+         * The sum of the X box can be calculated with:
+         *    X = e-d-b+a
+         *
+         * See https://en.wikipedia.org/wiki/Summed_area_table
+         *
+         * The compute*_ssd functions compute the integral image M where every entry
+         * contains the sum of the squared difference of every corresponding pixels of
+         * two input planes of the same size as M.
+         */
+        const uint32_t a = iia[x];
+        const uint32_t b = iib[x];
+        const uint32_t d = iid[x];
+        const uint32_t e = iie[x];
+        const uint32_t patch_diff_sq = e - d - b + a;
+
+        // most patches are too different to contribute when denoising
+        if (patch_diff_sq < max_meaningful_diff) {
+            const float weight = weight_lut[patch_diff_sq]; // exp(-patch_diff_sq * s->pdiff_scale)
+
+            total_weight[x] += weight;
+            sum[x] += weight * src[x];
+        }
+    }
+}
+
+static void fn(weight_averages)(pixel *dst, ptrdiff_t dst_linesize,
+                                const pixel *src, ptrdiff_t src_linesize,
+                                float *total_weight, float *sum, ptrdiff_t linesize,
+                                int w, int h)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            // Also weight the centered pixel
+            total_weight[x] += 1.f;
+            sum[x] += 1.f * src[x];
+#if DEPTH == 8
+            dst[x] = av_clip_uint8(sum[x] / total_weight[x] + 0.5f);
+#else
+            dst[x] = av_clip_uint16(sum[x] / total_weight[x] + 0.5f);
+#endif
+        }
+        dst += dst_linesize;
+        src += src_linesize;
+        total_weight += linesize;
+        sum += linesize;
+    }
+}
+
+/**
+ * Denoise a band of lines of the plane. The band is split into tiles, and
+ * every offset of the research window is applied to a tile before moving to
+ * the next one, so that the integral image of the tile and its weights stay
+ * in cache.
+ */
+static int fn(nlmeans_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NLMeansContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const int w = td->w;
+    const int h = td->h;
+    const int p = td->p;
+    const int r = td->r;
+    const int shift = s->shift;
+    const ptrdiff_t src_linesize = td->src_linesize / sizeof(pixel);
+    const pixel *src = (const pixel *)td->src;
+    const int slice_start = (h *  jobnr   ) / nb_jobs;
+    const int slice_end   = (h * (jobnr+1)) / nb_jobs;
+    const ptrdiff_t ii_lz_32 = s->ii_lz_32;
+    // skip top 0-line and left 0-column
+    uint32_t *ii = s->ii_orig[jobnr] + ii_lz_32 + 1;
+    const int dist_b = 2*p + 1;
+    const int dist_d = dist_b * ii_lz_32;
+    const int dist_e = dist_d + dist_b;
+    const float *const weight_lut = s->weight_lut;
+    const uint32_t max_meaningful_diff = s->max_meaningful_diff;
+    const NLMeansDSPContext *dsp = &s->dsp;
+
+    for (int y = slice_start; y < slice_end; y++) {
+        memset(s->total_weight + y*s->linesize, 0, s->linesize * sizeof(*s->total_weight));
+        memset(s->sum          + y*s->linesize, 0, s->linesize * sizeof(*s->sum));
+    }
+
+    for (int ty = slice_start; ty < slice_end; ty += NLMEANS_TILE_H) {
+        const int tile_endy = FFMIN(ty + NLMEANS_TILE_H, slice_end);
+
+        for (int tx = 0; tx < w; tx += NLMEANS_TILE_W) {
+            const int tile_endx = FFMIN(tx + NLMEANS_TILE_W, w);
+
+            for (int offy = -r; offy <= r; offy++) {
+                for (int offx = -r; offx <= r; offx++) {
+                    // only the pixels whose offset counterpart is in the plane
+                    const int startx = FFMAX(tx, -offx);
+                    const int starty = FFMAX(ty, -offy);
+                    const int endx   = FFMIN(tile_endx, w - offx);
+                    const int endy   = FFMIN(tile_endy, h - offy);
+
+                    if ((!offx && !offy) || startx >= endx || starty >= endy)
+                        continue;
+
+                    /* the patches centered on the pixels of the tile need
+                     * the integral image of the tile extended by p */
+                    fn(compute_ssd_integral_image)(dsp, ii, ii_lz_32,
+                                                   src, src_linesize,
+                                                   offx, offy, startx - p, starty - p,
+                                                   endx - startx + 2*p, endy - starty + 2*p,
+                                                   w, h, shift);
+
+                    for (int y = starty; y < endy; y++) {
+                        const uint32_t *const iia = ii + (y - starty - 1) * ii_lz_32 - 1;
+
+                        dsp->dspfn(compute_weights_line)(iia, iia + dist_b, iia + dist_d, iia + dist_e,
+                                                         src + (y + offy) * src_linesize + startx + offx,
+                                                         s->total_weight + y*s->linesize + startx,
+                                                         s->sum          + y*s->linesize + startx,
+                                                         weight_lut, max_meaningful_diff,
+                                                         0, endx - startx);
+                    }
+                }
+            }
+        }
+    }
+
+    fn(weight_averages)((pixel *)(td->dst + slice_start * td->dst_linesize),
+                        td->dst_linesize / sizeof(pixel),
+                        src + slice_start * src_linesize, src_linesize,
+                        s->total_weight + slice_start * s->linesize,
+                        s->sum          + slice_start * s->linesize,
+                        s->linesize, w, slice_end - slice_start);
+
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale the input to several resolutions at once, each output being
+ * scaled from the smallest larger one
+ */
+
+#include <stdio.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scale_eval.h"
+#include "video.h"
+
+typedef struct LadderRung {
+    int w, h;                   ///< requested size, may be negative
+    int out_w, out_h;           ///< actual output size
+    int src;                    ///< rung this one is scaled from, -1 for the input
+    struct SwsContext *sws;
+} LadderRung;
+
+typedef struct ScaleLadderContext {
+    const AVClass *class;
+    char *sizes_str;
+    char *flags_str;
+    int cascade;
+
+    LadderRung *rungs;
+    int nb_rungs;
+    int *order;                 ///< rung indices by decreasing area
+    AVFrame **frames;
+} ScaleLadderContext;
+
+static int parse_size(AVFilterContext *ctx, const char *str, int *w, int *h)
+{
+    char tail;
+
+    if (sscanf(str, "%dx%d%c", w, h, &tail) == 2)
+        return 0;
+    if (av_parse_video_size(w, h, str) >= 0)
+        return 0;
+    av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'\n", str);
+    return AVERROR(EINVAL);
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ScaleLadderContext *s = ctx->priv;
+    const LadderRung *rung = &s->rungs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->w = rung->out_w;
+    outlink->h = rung->out_h;
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+    char *sizes, *saveptr = NULL, *item;
+    int i, ret = 0;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (item = av_strtok(sizes, "|", &saveptr); item;
+         item = av_strtok(NULL, "|", &saveptr)) {
+        LadderRung *rung;
+
+        ret = av_reallocp_array(&s->rungs, s->nb_rungs + 1, sizeof(*s->rungs));
+        if (ret < 0) {
+            s->nb_rungs = 0;
+            goto end;
+        }
+        rung = &s->rungs[s->nb_rungs++];
+        memset(rung, 0, sizeof(*rung));
+        if ((ret = parse_size(ctx, item, &rung->w, &rung->h)) < 0)
+            goto end;
+    }
+
+    s->order  = av_calloc(s->nb_rungs, sizeof(*s->order));
+    s->frames = av_calloc(s->nb_rungs, sizeof(*s->frames));
+    if (!s->order || !s->frames) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (i = 0; i < s->nb_rungs; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", i);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+            goto end;
+    }
+
+end:
+    av_free(sizes);
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_rungs; i++)
+        sws_freeContext(s->rungs[i].sws);
+    av_freep(&s->rungs);
+    av_freep(&s->order);
+    av_freep(&s->frames);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *formats = NULL;
+    const AVPixFmtDescriptor *desc = NULL;
+    int ret;
+
+    /* all outputs use the input format, so that rungs can be cascaded */
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (!(desc->flags & AV_PIX_FMT_FLAG_HWACCEL) &&
+            sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    return ff_set_common_formats(ctx, formats);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleLadderContext *s = ctx->priv;
+    int i, j, ret;
+
+    for (i = 0; i < s->nb_rungs; i++) {
+        LadderRung *rung = &s->rungs[i];
+
+        rung->out_w = rung->w;
+        rung->out_h = rung->h;
+        ff_scale_adjust_dimensions(inlink, &rung->out_w, &rung->out_h, 0, 1);
+        if (rung->out_w <= 0 || rung->out_h <= 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size %dx%d for output %d\n",
+                   rung->out_w, rung->out_h, i);
+            return AVERROR(EINVAL);
+        }
+        s->order[i] = i;
+    }
+
+    /* insertion sort by decreasing area, keeping the option order on ties */
+    for (i = 1; i < s->nb_rungs; i++) {
+        int idx = s->order[i];
+        int64_t area = (int64_t)s->rungs[idx].out_w * s->rungs[idx].out_h;
+        for (j = i; j > 0; j--) {
+            const LadderRung *prev = &s->rungs[s->order[j - 1]];
+            if ((int64_t)prev->out_w * prev->out_h >= area)
+                break;
+            s->order[j] = s->order[j - 1];
+        }
+        s->order[j] = idx;
+    }
+
+    for (i = 0; i < s->nb_rungs; i++) {
+        LadderRung *rung = &s->rungs[s->order[i]];
+        int src_w = inlink->w, src_h = inlink->h;
+
+        /* scale from the smallest already scaled rung covering this one */
+        rung->src = -1;
+        for (j = i - 1; s->cascade && j >= 0; j--) {
+            const LadderRung *cand = &s->rungs[s->order[j]];
+            if (cand->out_w >= rung->out_w && cand->out_h >= rung->out_h &&
+                cand->out_w <= inlink->w && cand->out_h <= inlink->h) {
+                rung->src = s->order[j];
+                src_w     = cand->out_w;
+                src_h     = cand->out_h;
+                break;
+            }
+        }
+
+        sws_freeContext(rung->sws);
+        rung->sws = sws_alloc_context();
+        if (!rung->sws)
+            return AVERROR(ENOMEM);
+        av_opt_set_int(rung->sws, "srcw", src_w, 0);
+        av_opt_set_int(rung->sws, "srch", src_h, 0);
+        av_opt_set_int(rung->sws, "src_format", inlink->format, 0);
+        av_opt_set_int(rung->sws, "dstw", rung->out_w, 0);
+        av_opt_set_int(rung->sws, "dsth", rung->out_h, 0);
+        av_opt_set_int(rung->sws, "dst_format", inlink->format, 0);
+        av_opt_set_int(rung->sws, "threads", ff_filter_get_nb_threads(ctx), 0);
+        if ((ret = av_opt_set(rung->sws, "sws_flags", s->flags_str, 0)) < 0)
+            return ret;
+        if ((ret = sws_init_context(rung->sws, NULL, NULL)) < 0)
+            return ret;
+
+        av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d -> %dx%d from %s\n",
+               s->order[i], src_w, src_h, rung->out_w, rung->out_h,
+               rung->src < 0 ? "input" : "larger output");
+    }
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleLadderContext *s = ctx->priv;
+    int i, ret = 0;
+
+    for (i = 0; i < s->nb_rungs; i++) {
+        int idx = s->order[i];
+        const LadderRung *rung = &s->rungs[idx];
+        AVFilterLink *outlink = ctx->outputs[idx];
+        AVFrame *out;
+
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        s->frames[idx] = out;
+        if ((ret = av_frame_copy_props(out, in)) < 0)
+            goto end;
+        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+
+        ret = sws_scale_frame(rung->sws, out, rung->src < 0 ? in : s->frames[rung->src]);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = AVERROR_EOF;
+    for (i = 0; i < s->nb_rungs; i++) {
+        AVFrame *out = s->frames[i];
+
+        s->frames[i] = NULL;
+        if (ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&out);
+            continue;
+        }
+        ret = ff_filter_frame(ctx->outputs[i], out);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    for (i = 0; i < s->nb_rungs; i++)
+        av_frame_free(&s->frames[i]);
+    av_frame_free(&in);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(ScaleLadderContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scale_ladder_options[] = {
+    { "sizes",   "set the '|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL },      0, 0, FLAGS },
+    { "flags",   "set libswscale scaling flags",               OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "bicubic" }, 0, 0, FLAGS },
+    { "cascade", "scale outputs from larger outputs",          OFFSET(cascade),   AV_OPT_TYPE_BOOL,   { .i64 = 1 },         0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scale_ladder);
+
+static const AVFilterPad scale_ladder_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+};
+
+const AVFilter ff_vf_scale_ladder = {
+    .name          = "scale_ladder",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes."),
+    .priv_size     = sizeof(ScaleLadderContext),
+    .priv_class    = &scale_ladder_class,
+    .init          = init,
+    .uninit        = uninit,
+    FILTER_INPUTS(scale_ladder_inputs),
+    .outputs       = NULL,
+    FILTER_QUERY_FUNC(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
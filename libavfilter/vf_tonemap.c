@@ -60,6 +60,8 @@ static const struct LumaCoefficients luma_coefficients[AVCOL_SPC_NB] = {
     [AVCOL_SPC_BT2020_CL]  = { 0.2627, 0.6780, 0.0593 },
 };
 
+#define LUT_SIZE 4096
+
 typedef struct TonemapContext {
     const AVClass *class;
 
@@ -67,10 +69,59 @@ typedef struct TonemapContext {
     double param;
     double desat;
     double peak;
+    enum AVPixelFormat format;
 
     const struct LumaCoefficients *coeffs;
+
+    /* YUV input, the tables below are set up for these frame properties */
+    enum AVColorSpace spc;
+    enum AVColorPrimaries pri;
+    enum AVColorTransferCharacteristic trc;
+    enum AVColorRange range;
+    double lut_peak;
+
+    float yuv2rgb[3][3];
+    float rgb2rgb[3][3];
+    float rgb2yuv[3][3];
+    int rgb2rgb_passthrough;
+    float in_scale[3], in_offset[3];
+    float out_scale[3], out_offset[3];
+    float hlg_gamma;
+
+    float lin_lut[LUT_SIZE + 1];        ///< linear light, indexed by the signal value
+    float delin_lut[LUT_SIZE + 1];      ///< signal value, indexed by the 4th root of linear light
+    float tonemap_lut[LUT_SIZE + 1];    ///< tonemapped signal, indexed by signal / peak
+
+    float *buf;                         ///< per-thread rows of float samples
+    int buf_linesize;
 } TonemapContext;
 
+static const enum AVPixelFormat yuv_in_fmts[] = {
+    AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV420P12, AV_PIX_FMT_YUV420P16,
+    AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV422P12, AV_PIX_FMT_YUV422P16,
+    AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV444P12, AV_PIX_FMT_YUV444P16,
+    AV_PIX_FMT_P010, AV_PIX_FMT_P016,
+    AV_PIX_FMT_NONE
+};
+
+static const enum AVPixelFormat yuv_out_fmts[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10,
+    AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV422P10,
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV444P10,
+    AV_PIX_FMT_NV12, AV_PIX_FMT_P010,
+    AV_PIX_FMT_NONE
+};
+
+static const struct PrimaryCoefficients primaries_table[AVCOL_PRI_NB] = {
+    [AVCOL_PRI_BT709]  = { 0.640, 0.330, 0.300, 0.600, 0.150, 0.060 },
+    [AVCOL_PRI_BT2020] = { 0.708, 0.292, 0.170, 0.797, 0.131, 0.046 },
+};
+
+static const struct WhitepointCoefficients whitepoint_table[AVCOL_PRI_NB] = {
+    [AVCOL_PRI_BT709]  = { 0.3127, 0.3290 },
+    [AVCOL_PRI_BT2020] = { 0.3127, 0.3290 },
+};
+
 static av_cold int init(AVFilterContext *ctx)
 {
     TonemapContext *s = ctx->priv;
@@ -93,9 +144,52 @@ static av_cold int init(AVFilterContext *ctx)
     if (isnan(s->param))
         s->param = 1.0f;
 
+    if (s->format != AV_PIX_FMT_NONE) {
+        int i;
+        for (i = 0; yuv_out_fmts[i] != AV_PIX_FMT_NONE; i++)
+            if (yuv_out_fmts[i] == s->format)
+                break;
+        if (yuv_out_fmts[i] == AV_PIX_FMT_NONE) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported output format %s\n",
+                   av_get_pix_fmt_name(s->format));
+            return AVERROR(EINVAL);
+        }
+    }
+
     return 0;
 }
 
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat float_fmts[] = {
+        AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32, AV_PIX_FMT_NONE
+    };
+    TonemapContext *s = ctx->priv;
+    const AVPixFmtDescriptor *odesc;
+    AVFilterFormats *formats = NULL;
+    int ret;
+
+    if (s->format == AV_PIX_FMT_NONE)
+        return ff_set_common_formats_from_list(ctx, float_fmts);
+
+    /* no scaling is done, so the chroma subsampling must match */
+    odesc = av_pix_fmt_desc_get(s->format);
+    for (int i = 0; yuv_in_fmts[i] != AV_PIX_FMT_NONE; i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(yuv_in_fmts[i]);
+        if (desc->log2_chroma_w == odesc->log2_chroma_w &&
+            desc->log2_chroma_h == odesc->log2_chroma_h &&
+            (ret = ff_add_format(&formats, yuv_in_fmts[i])) < 0)
+            return ret;
+    }
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0)
+        return ret;
+
+    formats = NULL;
+    if ((ret = ff_add_format(&formats, s->format)) < 0)
+        return ret;
+    return ff_formats_ref(formats, &ctx->outputs[0]->incfg.formats);
+}
+
 static float hable(float in)
 {
     float a = 0.15f, b = 0.50f, c = 0.10f, d = 0.20f, e = 0.02f, f = 0.30f;
@@ -115,6 +209,37 @@ static float mobius(float in, float j, double peak)
     return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
 }
 
+static float map_signal(const TonemapContext *s, float sig, double peak)
+{
+    switch(s->tonemap) {
+    default:
+    case TONEMAP_NONE:
+        // do nothing
+        break;
+    case TONEMAP_LINEAR:
+        sig = sig * s->param / peak;
+        break;
+    case TONEMAP_GAMMA:
+        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
+                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
+        break;
+    case TONEMAP_CLIP:
+        sig = av_clipf(sig * s->param, 0, 1.0f);
+        break;
+    case TONEMAP_HABLE:
+        sig = hable(sig) / hable(peak);
+        break;
+    case TONEMAP_REINHARD:
+        sig = sig / (sig + s->param) * (peak + s->param) / peak;
+        break;
+    case TONEMAP_MOBIUS:
+        sig = mobius(sig, s->param, peak);
+        break;
+    }
+
+    return sig;
+}
+
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
 static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
                     const AVPixFmtDescriptor *desc, int x, int y, double peak)
@@ -148,31 +273,7 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
     sig_orig = sig;
 
-    switch(s->tonemap) {
-    default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
-    }
+    sig = map_signal(s, sig, peak);
 
     /* apply the computed scale factor to the color,
      * linearly to prevent discoloration */
@@ -184,6 +285,7 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
 typedef struct ThreadData {
     AVFrame *in, *out;
     const AVPixFmtDescriptor *desc;
+    const AVPixFmtDescriptor *odesc;
     double peak;
 } ThreadData;
 
@@ -205,6 +307,362 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     return 0;
 }
 
+#define ST2084_MAX_LUMINANCE 10000.0f
+#define ST2084_M1 0.1593017578125f
+#define ST2084_M2 78.84375f
+#define ST2084_C1 0.8359375f
+#define ST2084_C2 18.8515625f
+#define ST2084_C3 18.6875f
+
+#define HLG_A 0.17883277f
+#define HLG_B 0.28466892f
+#define HLG_C 0.55991073f
+
+static float eotf_st2084(float x)
+{
+    float p = powf(x, 1.0f / ST2084_M2);
+    float a = FFMAX(p - ST2084_C1, 0.0f);
+    float b = FFMAX(ST2084_C2 - ST2084_C3 * p, 1e-6f);
+    float c = powf(a / b, 1.0f / ST2084_M1);
+    return x > 0.0f ? c * ST2084_MAX_LUMINANCE / REFERENCE_WHITE : 0.0f;
+}
+
+static float inverse_oetf_hlg(float x)
+{
+    return x < 0.5f ? 4.0f * x * x : expf((x - HLG_C) / HLG_A) + HLG_B;
+}
+
+static av_always_inline float lut_lookup(const float *lut, float x)
+{
+    const float pos = av_clipf(x, 0.0f, 1.0f) * LUT_SIZE;
+    const int idx = FFMIN((int)pos, LUT_SIZE - 1);
+
+    return lut[idx] + (lut[idx + 1] - lut[idx]) * (pos - idx);
+}
+
+static void fill_matrix(float dst[3][3], const double src[3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            dst[i][j] = src[i][j];
+}
+
+/**
+ * Set up the matrices and tables used to convert HDR YUV to SDR BT.709.
+ * They only depend on the frame properties and the peak, which rarely change.
+ */
+static int config_yuv(AVFilterContext *ctx, const AVFrame *in, double peak,
+                      const AVPixFmtDescriptor *desc, const AVPixFmtDescriptor *odesc)
+{
+    TonemapContext *s = ctx->priv;
+    enum AVColorSpace spc = in->colorspace;
+    enum AVColorPrimaries pri = in->color_primaries;
+    double rgb2yuv[3][3], yuv2rgb[3][3];
+    int full;
+
+    if (spc == s->spc && pri == s->pri && in->color_trc == s->trc &&
+        in->color_range == s->range && peak == s->lut_peak)
+        return 0;
+
+    if (in->color_trc != AVCOL_TRC_SMPTE2084 && in->color_trc != AVCOL_TRC_ARIB_STD_B67) {
+        av_log(ctx, AV_LOG_ERROR, "Unsupported transfer characteristic '%s', "
+               "only smpte2084 and arib-std-b67 are supported with YUV input\n",
+               av_color_transfer_name(in->color_trc));
+        return AVERROR(ENOSYS);
+    }
+
+    s->coeffs = ff_get_luma_coefficients(spc);
+    if (!s->coeffs) {
+        av_log(ctx, AV_LOG_WARNING, "Unsupported color space '%s', assuming bt2020nc\n",
+               av_color_space_name(spc));
+        s->coeffs = ff_get_luma_coefficients(AVCOL_SPC_BT2020_NCL);
+    }
+    ff_fill_rgb2yuv_table(s->coeffs, rgb2yuv);
+    ff_matrix_invert_3x3(rgb2yuv, yuv2rgb);
+    fill_matrix(s->yuv2rgb, yuv2rgb);
+
+    ff_fill_rgb2yuv_table(ff_get_luma_coefficients(AVCOL_SPC_BT709), rgb2yuv);
+    fill_matrix(s->rgb2yuv, rgb2yuv);
+
+    if (pri != AVCOL_PRI_BT709 && pri != AVCOL_PRI_BT2020) {
+        av_log(ctx, AV_LOG_WARNING, "Unsupported color primaries '%s', assuming bt2020\n",
+               av_color_primaries_name(pri));
+        pri = AVCOL_PRI_BT2020;
+    }
+    s->rgb2rgb_passthrough = pri == AVCOL_PRI_BT709;
+    if (!s->rgb2rgb_passthrough) {
+        double rgb2xyz[3][3], xyz2rgb[3][3], rgb2rgb[3][3];
+
+        ff_fill_rgb2xyz_table(&primaries_table[AVCOL_PRI_BT709],
+                              &whitepoint_table[AVCOL_PRI_BT709], rgb2xyz);
+        ff_matrix_invert_3x3(rgb2xyz, xyz2rgb);
+        ff_fill_rgb2xyz_table(&primaries_table[pri], &whitepoint_table[pri], rgb2xyz);
+        ff_matrix_mul_3x3(rgb2rgb, rgb2xyz, xyz2rgb);
+        fill_matrix(s->rgb2rgb, rgb2rgb);
+    }
+
+    /* normalize luma to [0, 1] and chroma to [-0.5, 0.5] */
+    full = in->color_range == AVCOL_RANGE_JPEG;
+    for (int i = 0; i < 3; i++) {
+        const float in_mul  = 1 << (desc->comp[i].depth - 8);
+        const float out_mul = 1 << (odesc->comp[i].depth - 8);
+        const float in_max  = (1 << desc->comp[i].depth) - 1;
+        const float out_max = (1 << odesc->comp[i].depth) - 1;
+
+        if (full) {
+            s->in_scale[i]   = 1.0f / in_max;
+            s->in_offset[i]  = i ? -(1 << (desc->comp[i].depth - 1)) / in_max : 0.0f;
+            s->out_scale[i]  = out_max;
+            s->out_offset[i] = i ? 1 << (odesc->comp[i].depth - 1) : 0.0f;
+        } else {
+            s->in_scale[i]   = 1.0f / ((i ? 224.0f : 219.0f) * in_mul);
+            s->in_offset[i]  = i ? -128.0f / 224.0f : -16.0f / 219.0f;
+            s->out_scale[i]  = (i ? 224.0f : 219.0f) * out_mul;
+            s->out_offset[i] = (i ? 128.0f : 16.0f) * out_mul;
+        }
+    }
+
+    s->hlg_gamma = FFMAX(1.0f, 1.2f + 0.42f * log10f(peak * REFERENCE_WHITE / 1000.0f));
+    for (int i = 0; i <= LUT_SIZE; i++) {
+        const float x = i / (float)LUT_SIZE;
+
+        s->lin_lut[i] = in->color_trc == AVCOL_TRC_SMPTE2084 ? eotf_st2084(x)
+                                                            : inverse_oetf_hlg(x);
+        /* BT.1886 inverse EOTF, indexed by x^(1/4) to keep its steep start accurate */
+        s->delin_lut[i] = powf(x, 4.0f / 2.4f);
+        s->tonemap_lut[i] = map_signal(s, FFMAX(x * peak, 1e-6), peak);
+    }
+
+    s->spc      = spc;
+    s->pri      = in->color_primaries;
+    s->trc      = in->color_trc;
+    s->range    = in->color_range;
+    s->lut_peak = peak;
+
+    return 0;
+}
+
+static void read_row(float *dst, const AVFrame *f, const AVComponentDescriptor *c,
+                     int y, int w, int padded_w, float scale, float offset)
+{
+    const uint8_t *src = f->data[c->plane] + y * f->linesize[c->plane] + c->offset;
+    const int step = c->step, shift = c->shift;
+    int x;
+
+    for (x = 0; x < w; x++)
+        dst[x] = (AV_RN16(src + x * step) >> shift) * scale + offset;
+    for (; x < padded_w; x++)
+        dst[x] = dst[w - 1];
+}
+
+static void write_row(AVFrame *f, const AVComponentDescriptor *c, int y,
+                      const float *src, int w, float scale, float offset)
+{
+    uint8_t *dst = f->data[c->plane] + y * f->linesize[c->plane] + c->offset;
+    const int step = c->step, shift = c->shift, depth = c->depth;
+
+    if (depth > 8) {
+        for (int x = 0; x < w; x++)
+            AV_WN16(dst + x * step, av_clip_uintp2(lrintf(src[x] * scale + offset), depth) << shift);
+    } else {
+        for (int x = 0; x < w; x++)
+            dst[x * step] = av_clip_uint8(lrintf(src[x] * scale + offset));
+    }
+}
+
+static void mul_matrix_row(float *a, float *b, float *c, const float m[3][3], int w)
+{
+    const float m00 = m[0][0], m01 = m[0][1], m02 = m[0][2];
+    const float m10 = m[1][0], m11 = m[1][1], m12 = m[1][2];
+    const float m20 = m[2][0], m21 = m[2][1], m22 = m[2][2];
+
+    for (int x = 0; x < w; x++) {
+        const float x0 = a[x], x1 = b[x], x2 = c[x];
+        a[x] = m00 * x0 + m01 * x1 + m02 * x2;
+        b[x] = m10 * x0 + m11 * x1 + m12 * x2;
+        c[x] = m20 * x0 + m21 * x1 + m22 * x2;
+    }
+}
+
+/**
+ * Tonemap a row of normalized YUV samples in place. Every step is done on
+ * the whole row so that the arithmetic ones can be vectorized.
+ */
+static void tonemap_yuv_row(const TonemapContext *s, float peak,
+                            float *y, float *u, float *v, int w)
+{
+    const struct LumaCoefficients *coeffs = s->coeffs;
+    const float cr = coeffs->cr, cg = coeffs->cg, cb = coeffs->cb;
+    const float desat = s->desat;
+    const float inv_peak = 1.0f / peak;
+    float *r = y, *g = u, *b = v;
+
+    mul_matrix_row(r, g, b, s->yuv2rgb, w);
+
+    for (int x = 0; x < w; x++) {
+        r[x] = lut_lookup(s->lin_lut, r[x]);
+        g[x] = lut_lookup(s->lin_lut, g[x]);
+        b[x] = lut_lookup(s->lin_lut, b[x]);
+    }
+
+    if (s->trc == AVCOL_TRC_ARIB_STD_B67) {
+        /* HLG OOTF, scene to display light */
+        const float gamma = s->hlg_gamma - 1.0f;
+        const float scale = peak / powf(12.0f, s->hlg_gamma);
+        for (int x = 0; x < w; x++) {
+            const float luma = FFMAX(cr * r[x] + cg * g[x] + cb * b[x], 1e-6f);
+            const float factor = scale * powf(luma, gamma);
+            r[x] *= factor;
+            g[x] *= factor;
+            b[x] *= factor;
+        }
+    }
+
+    if (desat > 0) {
+        for (int x = 0; x < w; x++) {
+            const float luma = cr * r[x] + cg * g[x] + cb * b[x];
+            const float overbright = FFMAX(luma - desat, 1e-6f) / FFMAX(luma, 1e-6f);
+            r[x] = MIX(r[x], luma, overbright);
+            g[x] = MIX(g[x], luma, overbright);
+            b[x] = MIX(b[x], luma, overbright);
+        }
+    }
+
+    for (int x = 0; x < w; x++) {
+        const float sig = FFMAX(FFMAX3(r[x], g[x], b[x]), 1e-6f);
+        const float factor = lut_lookup(s->tonemap_lut, sig * inv_peak) / sig;
+        r[x] *= factor;
+        g[x] *= factor;
+        b[x] *= factor;
+    }
+
+    if (!s->rgb2rgb_passthrough)
+        mul_matrix_row(r, g, b, s->rgb2rgb, w);
+
+    for (int x = 0; x < w; x++) {
+        r[x] = lut_lookup(s->delin_lut, sqrtf(sqrtf(FFMAX(r[x], 0.0f))));
+        g[x] = lut_lookup(s->delin_lut, sqrtf(sqrtf(FFMAX(g[x], 0.0f))));
+        b[x] = lut_lookup(s->delin_lut, sqrtf(sqrtf(FFMAX(b[x], 0.0f))));
+    }
+
+    mul_matrix_row(r, g, b, s->rgb2yuv, w);
+}
+
+enum {
+    BUF_Y, BUF_U, BUF_V, BUF_CHROMA_U, BUF_CHROMA_V, BUF_SUM_U, BUF_SUM_V,
+    NB_BUFS,
+};
+
+static int tonemap_yuv_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const TonemapContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *in = td->in;
+    AVFrame *out = td->out;
+    const AVComponentDescriptor *ic = td->desc->comp;
+    const AVComponentDescriptor *oc = td->odesc->comp;
+    const int ssw = td->desc->log2_chroma_w;
+    const int ssh = td->desc->log2_chroma_h;
+    const int cw = AV_CEIL_RSHIFT(in->width,  ssw);
+    const int ch = AV_CEIL_RSHIFT(in->height, ssh);
+    const int w = cw << ssw;
+    const int slice_start = (ch *  jobnr     ) / nb_jobs;
+    const int slice_end   = (ch * (jobnr + 1)) / nb_jobs;
+    float *buf[NB_BUFS];
+
+    for (int i = 0; i < NB_BUFS; i++)
+        buf[i] = s->buf + (jobnr * NB_BUFS + i) * s->buf_linesize;
+
+    /* each chroma sample is shared by a block of luma samples, whose
+     * tonemapped chroma values are averaged */
+    for (int cy = slice_start; cy < slice_end; cy++) {
+        const int y_end = FFMIN((cy + 1) << ssh, in->height);
+        const float norm = 1.0f / ((y_end - (cy << ssh)) << ssw);
+
+        read_row(buf[BUF_CHROMA_U], in, &ic[1], cy, cw, cw, s->in_scale[1], s->in_offset[1]);
+        read_row(buf[BUF_CHROMA_V], in, &ic[2], cy, cw, cw, s->in_scale[2], s->in_offset[2]);
+        memset(buf[BUF_SUM_U], 0, cw * sizeof(float));
+        memset(buf[BUF_SUM_V], 0, cw * sizeof(float));
+
+        for (int y = cy << ssh; y < y_end; y++) {
+            read_row(buf[BUF_Y], in, &ic[0], y, in->width, w, s->in_scale[0], s->in_offset[0]);
+            for (int x = 0; x < w; x++) {
+                buf[BUF_U][x] = buf[BUF_CHROMA_U][x >> ssw];
+                buf[BUF_V][x] = buf[BUF_CHROMA_V][x >> ssw];
+            }
+
+            tonemap_yuv_row(s, td->peak, buf[BUF_Y], buf[BUF_U], buf[BUF_V], w);
+
+            write_row(out, &oc[0], y, buf[BUF_Y], in->width, s->out_scale[0], s->out_offset[0]);
+            for (int x = 0; x < w; x++) {
+                buf[BUF_SUM_U][x >> ssw] += buf[BUF_U][x];
+                buf[BUF_SUM_V][x >> ssw] += buf[BUF_V][x];
+            }
+        }
+
+        write_row(out, &oc[1], cy, buf[BUF_SUM_U], cw, s->out_scale[1] * norm, s->out_offset[1]);
+        write_row(out, &oc[2], cy, buf[BUF_SUM_V], cw, s->out_scale[2] * norm, s->out_offset[2]);
+    }
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    TonemapContext *s = ctx->priv;
+
+    if (s->format == AV_PIX_FMT_NONE)
+        return 0;
+
+    /* room for the luma width rounded up to a whole number of chroma samples */
+    s->buf_linesize = FFALIGN(ctx->inputs[0]->w + 1, 16);
+    av_freep(&s->buf);
+    s->buf = av_calloc(ff_filter_get_nb_threads(ctx) * NB_BUFS * s->buf_linesize,
+                       sizeof(*s->buf));
+    if (!s->buf)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    TonemapContext *s = ctx->priv;
+
+    av_freep(&s->buf);
+}
+
+static int filter_frame_yuv(AVFilterContext *ctx, AVFrame *in, AVFrame *out, double peak,
+                            const AVPixFmtDescriptor *desc, const AVPixFmtDescriptor *odesc)
+{
+    ThreadData td;
+    int ret;
+
+    if ((ret = config_yuv(ctx, in, peak, desc, odesc)) < 0)
+        return ret;
+
+    td.in    = in;
+    td.out   = out;
+    td.desc  = desc;
+    td.odesc = odesc;
+    td.peak  = peak;
+    ff_filter_execute(ctx, tonemap_yuv_slice, &td, NULL,
+                      FFMIN(AV_CEIL_RSHIFT(in->height, desc->log2_chroma_h),
+                            ff_filter_get_nb_threads(ctx)));
+
+    out->color_trc       = AVCOL_TRC_BT709;
+    out->color_primaries = AVCOL_PRI_BT709;
+    out->colorspace      = AVCOL_SPC_BT709;
+    out->color_range     = in->color_range == AVCOL_RANGE_JPEG ? AVCOL_RANGE_JPEG
+                                                               : AVCOL_RANGE_MPEG;
+    /* the output is SDR */
+    av_frame_remove_side_data(out, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+    av_frame_remove_side_data(out, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     AVFilterContext *ctx = link->dst;
@@ -235,6 +693,18 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         return ret;
     }
 
+    if (s->format != AV_PIX_FMT_NONE) {
+        if (!peak)
+            peak = ff_determine_signal_peak(in);
+        ret = filter_frame_yuv(ctx, in, out, peak, desc, odesc);
+        av_frame_free(&in);
+        if (ret < 0) {
+            av_frame_free(&out);
+            return ret;
+        }
+        return ff_filter_frame(outlink, out);
+    }
+
     /* input and output transfer will be linear */
     if (in->color_trc == AVCOL_TRC_UNSPECIFIED) {
         av_log(s, AV_LOG_WARNING, "Untagged transfer, assuming linear light\n");
@@ -303,6 +773,7 @@ static const AVOption tonemap_options[] = {
     { "param",        "tonemap parameter", OFFSET(param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
     { "desat",        "desaturation strength", OFFSET(desat), AV_OPT_TYPE_DOUBLE, {.dbl = 2}, 0, DBL_MAX, FLAGS },
     { "peak",         "signal peak override", OFFSET(peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
+    { "format",       "output pixel format for YUV input", OFFSET(format), AV_OPT_TYPE_PIXEL_FMT, {.i64 = AV_PIX_FMT_NONE}, AV_PIX_FMT_NONE, INT_MAX, FLAGS },
     { NULL }
 };
 
@@ -320,6 +791,7 @@ static const AVFilterPad tonemap_outputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_output,
     },
 };
 
@@ -327,10 +799,11 @@ const AVFilter ff_vf_tonemap = {
     .name            = "tonemap",
     .description     = NULL_IF_CONFIG_SMALL("Conversion to/from different dynamic ranges."),
     .init            = init,
+    .uninit          = uninit,
     .priv_size       = sizeof(TonemapContext),
     .priv_class      = &tonemap_class,
     FILTER_INPUTS(tonemap_inputs),
     FILTER_OUTPUTS(tonemap_outputs),
-    FILTER_PIXFMTS(AV_PIX_FMT_GBRPF32, AV_PIX_FMT_GBRAPF32),
+    FILTER_QUERY_FUNC(query_formats),
     .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -36,9 +36,13 @@
 #include <math.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
@@ -167,6 +171,7 @@ static const AVOption v360_options[] = {
     {  "v_offset", "output vertical off-axis offset",  OFFSET(v_offset), AV_OPT_TYPE_FLOAT,{.dbl=0.f},       -1.f,                 1.f,TFLAGS, "v_offset"},
     {"alpha_mask", "build mask in alpha plane",      OFFSET(alpha), AV_OPT_TYPE_BOOL,   {.i64=0},               0,                   1, FLAGS, "alpha"},
     { "reset_rot", "reset rotation",             OFFSET(reset_rot), AV_OPT_TYPE_BOOL,   {.i64=0},              -1,                   1,TFLAGS, "reset_rot"},
+    {  "map_file", "set remap tables cache file",     OFFSET(map_file), AV_OPT_TYPE_STRING, {.str=NULL},            0,                   0, FLAGS, "map_file"},
     { NULL }
 };
 
@@ -4123,37 +4128,398 @@ static inline void input_flip(int16_t u[4][4], int16_t v[4][4], int w, int h, in
     }
 }
 
-static int allocate_plane(V360Context *s, int sizeof_uv, int sizeof_ker, int sizeof_mask, int p)
+/**
+ * Remap tables, shared by all filter instances computing the same ones.
+ */
+struct V360Maps {
+    V360Maps *next;
+    char *key;
+    unsigned usage_count;
+    int nb_allocated;
+    int16_t *u[2], *v[2], *ker[2];
+    uint8_t *mask;
+};
+
+static AVMutex maps_mutex = AV_MUTEX_INITIALIZER;
+static V360Maps *maps_list;
+
+#define MAP_FILE_TAG        "FFV360M2"
+#define MAP_FILE_HEADER_SIZE 24
+
+static size_t table_size(const V360Context *s, int p)
 {
-    const int pr_height = s->pr_height[p];
+    return (size_t)s->uv_linesize[p] * s->pr_height[p] * s->elements * sizeof(int16_t);
+}
 
-    for (int n = 0; n < s->nb_threads; n++) {
-        SliceXYRemap *r = &s->slice_remap[n];
-        const int slice_start = (pr_height *  n     ) / s->nb_threads;
-        const int slice_end   = (pr_height * (n + 1)) / s->nb_threads;
-        const int height = slice_end - slice_start;
-
-        if (!r->u[p])
-            r->u[p] = av_calloc(s->uv_linesize[p] * height, sizeof_uv);
-        if (!r->v[p])
-            r->v[p] = av_calloc(s->uv_linesize[p] * height, sizeof_uv);
-        if (!r->u[p] || !r->v[p])
+static size_t mask_table_size(const V360Context *s)
+{
+    return (size_t)s->pr_width[0] * s->pr_height[0] * s->mask_size;
+}
+
+static void free_maps(V360Maps *maps)
+{
+    if (!maps)
+        return;
+    for (int p = 0; p < maps->nb_allocated; p++) {
+        av_freep(&maps->u[p]);
+        av_freep(&maps->v[p]);
+        av_freep(&maps->ker[p]);
+    }
+    av_freep(&maps->mask);
+    av_freep(&maps->key);
+    av_free(maps);
+}
+
+static void release_maps(V360Maps **pmaps)
+{
+    V360Maps *maps = *pmaps, **next;
+
+    if (!maps)
+        return;
+    *pmaps = NULL;
+
+    ff_mutex_lock(&maps_mutex);
+    if (--maps->usage_count) {
+        maps = NULL;
+    } else {
+        for (next = &maps_list; *next != maps; next = &(*next)->next)
+            ;
+        *next = maps->next;
+    }
+    ff_mutex_unlock(&maps_mutex);
+
+    free_maps(maps);
+}
+
+/**
+ * Build the string identifying the remap tables, made of everything
+ * they are computed from.
+ */
+static char *maps_key(AVFilterContext *ctx)
+{
+    V360Context *s = ctx->priv;
+    const AVFilterLink *inlink = ctx->inputs[0];
+    char *map_file = s->map_file, *opts, *key;
+    int ret;
+
+    /* the cache file location does not change the tables */
+    s->map_file = NULL;
+    ret = av_opt_serialize(s, AV_OPT_FLAG_FILTERING_PARAM, 0, &opts, '=', ':');
+    s->map_file = map_file;
+    if (ret < 0)
+        return NULL;
+
+    key = av_asprintf("%s|%dx%d|%s|%s|%a,%a,%a,%a", opts, inlink->w, inlink->h,
+                      av_get_pix_fmt_name(inlink->format), HAVE_BIGENDIAN ? "be" : "le",
+                      s->rot_quaternion[0][0], s->rot_quaternion[0][1],
+                      s->rot_quaternion[0][2], s->rot_quaternion[0][3]);
+    av_free(opts);
+    return key;
+}
+
+static size_t map_file_data_offset(const char *key)
+{
+    return FFALIGN(MAP_FILE_HEADER_SIZE + strlen(key) + 1, 16);
+}
+
+static size_t maps_size(const V360Context *s, int has_ker, int has_mask)
+{
+    size_t size = has_mask ? mask_table_size(s) : 0;
+
+    for (int p = 0; p < s->nb_allocated; p++)
+        size += table_size(s, p) * (2 + has_ker);
+    return size;
+}
+
+/**
+ * Call fn on each table in the order they are stored in the cache file.
+ */
+static int for_each_table(const V360Context *s, const V360Maps *maps,
+                          int (*fn)(void *opaque, void *buf, size_t size), void *opaque)
+{
+    int ret;
+
+    for (int p = 0; p < maps->nb_allocated; p++) {
+        if ((ret = fn(opaque, maps->u[p], table_size(s, p))) < 0 ||
+            (ret = fn(opaque, maps->v[p], table_size(s, p))) < 0 ||
+            (maps->ker[p] && (ret = fn(opaque, maps->ker[p], table_size(s, p))) < 0))
+            return ret;
+    }
+    if (maps->mask && (ret = fn(opaque, maps->mask, mask_table_size(s))) < 0)
+        return ret;
+    return 0;
+}
+
+static int crc_table(void *opaque, void *buf, size_t size)
+{
+    uint32_t *crc = opaque;
+
+    *crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), *crc, buf, size);
+    return 0;
+}
+
+static int read_table(void *opaque, void *buf, size_t size)
+{
+    return fread(buf, size, 1, opaque) == 1 ? 0 : AVERROR_INVALIDDATA;
+}
+
+static int write_table(void *opaque, void *buf, size_t size)
+{
+    return fwrite(buf, size, 1, opaque) == 1 ? 0 : AVERROR(EIO);
+}
+
+static uint32_t maps_crc(const V360Context *s, const V360Maps *maps)
+{
+    uint32_t crc = 0;
+
+    for_each_table(s, maps, crc_table, &crc);
+    return crc;
+}
+
+/**
+ * Check that the tables only point into the input planes.
+ */
+static int check_maps(const V360Context *s, const V360Maps *maps)
+{
+    for (int p = 0; p < maps->nb_allocated; p++) {
+        const int n = s->pr_width[p] * s->elements;
+
+        for (int j = 0; j < s->pr_height[p]; j++) {
+            const int16_t *u = maps->u[p] + (ptrdiff_t)j * s->uv_linesize[p] * s->elements;
+            const int16_t *v = maps->v[p] + (ptrdiff_t)j * s->uv_linesize[p] * s->elements;
+
+            for (int i = 0; i < n; i++) {
+                if (u[i] < 0 || u[i] >= s->inplanewidth[p] ||
+                    v[i] < 0 || v[i] >= s->inplaneheight[p])
+                    return AVERROR_INVALIDDATA;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Read the tables from a cache file written by save_map_file().
+ * The file is read rather than mapped, so that it being truncated
+ * or rewritten while in use cannot affect the filter.
+ *
+ * @return 0 if the tables were read, a negative value if the file is missing,
+ *         was made for other tables or is corrupted
+ */
+static int load_map_file(AVFilterContext *ctx, V360Maps *maps)
+{
+    V360Context *s = ctx->priv;
+    const size_t key_size = strlen(maps->key) + 1;
+    const size_t offset = map_file_data_offset(maps->key);
+    uint8_t header[MAP_FILE_HEADER_SIZE];
+    char *key = NULL;
+    FILE *f;
+    int ret = AVERROR_INVALIDDATA;
+
+    f = av_fopen_utf8(s->map_file, "rb");
+    if (!f)
+        return AVERROR(errno);
+
+    if (fread(header, sizeof(header), 1, f) != 1 || memcmp(header, MAP_FILE_TAG, 8) ||
+        AV_RL32(header + 8) != key_size ||
+        AV_RL64(header + 16) != maps_size(s, !!maps->ker[0], !!maps->mask))
+        goto mismatch;
+
+    key = av_malloc(key_size);
+    if (!key) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if (fread(key, key_size, 1, f) != 1 || memcmp(key, maps->key, key_size) ||
+        fseek(f, offset, SEEK_SET) || for_each_table(s, maps, read_table, f) < 0)
+        goto mismatch;
+
+    if (maps_crc(s, maps) != AV_RL32(header + 12)) {
+        av_log(ctx, AV_LOG_WARNING, "Cache file '%s' is corrupted, ignoring it\n",
+               s->map_file);
+        goto end;
+    }
+    if (check_maps(s, maps) < 0) {
+        av_log(ctx, AV_LOG_WARNING, "Cache file '%s' has out of range tables, ignoring it\n",
+               s->map_file);
+        goto end;
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "Loaded remap tables from '%s'\n", s->map_file);
+    ret = 0;
+    goto end;
+mismatch:
+    av_log(ctx, AV_LOG_VERBOSE, "Cache file '%s' does not match, ignoring it\n",
+           s->map_file);
+end:
+    av_free(key);
+    fclose(f);
+    return ret;
+}
+
+static int save_map_file(AVFilterContext *ctx, const V360Maps *maps)
+{
+    V360Context *s = ctx->priv;
+    const size_t key_size = strlen(maps->key) + 1;
+    const size_t offset = map_file_data_offset(maps->key);
+    uint8_t header[MAP_FILE_HEADER_SIZE] = MAP_FILE_TAG;
+    static const uint8_t zero[16] = { 0 };
+    char *tmp_name;
+    FILE *f;
+    int ok;
+
+    AV_WL32(header +  8, key_size);
+    AV_WL32(header + 12, maps_crc(s, maps));
+    AV_WL64(header + 16, maps_size(s, !!maps->ker[0], !!maps->mask));
+
+    /* write to a temporary file so that concurrent readers never see a partial one */
+    tmp_name = av_asprintf("%s.%p.tmp", s->map_file, (void *)maps);
+    if (!tmp_name)
+        return AVERROR(ENOMEM);
+    f = av_fopen_utf8(tmp_name, "wb");
+    if (!f) {
+        av_log(ctx, AV_LOG_WARNING, "Cannot create cache file '%s'\n", tmp_name);
+        av_free(tmp_name);
+        return AVERROR(errno);
+    }
+
+    ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+         fwrite(maps->key, key_size, 1, f) == 1 &&
+         fwrite(zero, offset - MAP_FILE_HEADER_SIZE - key_size, 1, f) == 1;
+    ok = ok && for_each_table(s, maps, write_table, f) >= 0;
+    ok = !fclose(f) && ok;
+
+    if (!ok || rename(tmp_name, s->map_file)) {
+        av_log(ctx, AV_LOG_WARNING, "Cannot write cache file '%s'\n", s->map_file);
+        remove(tmp_name);
+        av_free(tmp_name);
+        return AVERROR(EIO);
+    }
+
+    av_free(tmp_name);
+    return 0;
+}
+
+static int allocate_maps(const V360Context *s, V360Maps *maps, int has_ker, int has_mask)
+{
+    for (int p = 0; p < s->nb_allocated; p++) {
+        maps->u[p] = av_malloc(table_size(s, p));
+        maps->v[p] = av_malloc(table_size(s, p));
+        if (!maps->u[p] || !maps->v[p])
             return AVERROR(ENOMEM);
-        if (sizeof_ker) {
-            if (!r->ker[p])
-                r->ker[p] = av_calloc(s->uv_linesize[p] * height, sizeof_ker);
-            if (!r->ker[p])
+        if (has_ker) {
+            maps->ker[p] = av_malloc(table_size(s, p));
+            if (!maps->ker[p])
                 return AVERROR(ENOMEM);
         }
+    }
 
-        if (sizeof_mask && !p) {
-            if (!r->mask)
-                r->mask = av_calloc(s->pr_width[p] * height, sizeof_mask);
-            if (!r->mask)
-                return AVERROR(ENOMEM);
+    if (has_mask) {
+        maps->mask = av_malloc(mask_table_size(s));
+        if (!maps->mask)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static void set_slice_remap(V360Context *s)
+{
+    const V360Maps *maps = s->maps;
+
+    for (int n = 0; n < s->nb_threads; n++) {
+        SliceXYRemap *r = &s->slice_remap[n];
+
+        for (int p = 0; p < s->nb_allocated; p++) {
+            const int slice_start = (s->pr_height[p] * n) / s->nb_threads;
+            const ptrdiff_t offset = (ptrdiff_t)slice_start * s->uv_linesize[p] * s->elements;
+
+            r->u[p]   = maps->u[p] + offset;
+            r->v[p]   = maps->v[p] + offset;
+            r->ker[p] = maps->ker[p] ? maps->ker[p] + offset : NULL;
         }
+
+        r->mask = maps->mask ? maps->mask + (ptrdiff_t)((s->pr_height[0] * n) / s->nb_threads) *
+                                            s->pr_width[0] * s->mask_size : NULL;
+    }
+}
+
+static int v360_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
+/**
+ * Set up the remap tables, reusing those of another instance or of the
+ * cache file when they were computed from the same parameters.
+ */
+static int get_maps(AVFilterContext *ctx, int has_ker, int has_mask)
+{
+    V360Context *s = ctx->priv;
+    V360Maps *old = s->maps, *maps, *other;
+    char *key;
+    int ret;
+
+    key = maps_key(ctx);
+    if (!key)
+        return AVERROR(ENOMEM);
+
+    ff_mutex_lock(&maps_mutex);
+    for (maps = maps_list; maps && strcmp(maps->key, key); maps = maps->next)
+        ;
+    if (maps)
+        maps->usage_count++;
+    ff_mutex_unlock(&maps_mutex);
+
+    if (maps) {
+        av_free(key);
+        s->maps = maps;
+        set_slice_remap(s);
+        release_maps(&old);
+        return 0;
+    }
+
+    maps = av_mallocz(sizeof(*maps));
+    if (!maps) {
+        av_free(key);
+        return AVERROR(ENOMEM);
+    }
+    maps->key          = key;
+    maps->usage_count  = 1;
+    maps->nb_allocated = s->nb_allocated;
+    s->maps = maps;
+
+    ret = allocate_maps(s, maps, has_ker, has_mask);
+    if (ret < 0) {
+        free_maps(maps);
+        s->maps = old;
+        return ret;
     }
 
+    /* compute the tables, and rewrite the cache file if it did not hold them */
+    if (!s->map_file || load_map_file(ctx, maps) < 0) {
+        set_slice_remap(s);
+        ff_filter_execute(ctx, v360_slice, NULL, NULL, s->nb_threads);
+        if (s->map_file)
+            save_map_file(ctx, maps);
+    }
+
+    /* another instance may have computed the same tables meanwhile */
+    ff_mutex_lock(&maps_mutex);
+    for (other = maps_list; other && strcmp(other->key, key); other = other->next)
+        ;
+    if (other) {
+        other->usage_count++;
+    } else {
+        maps->next = maps_list;
+        maps_list  = maps;
+    }
+    ff_mutex_unlock(&maps_mutex);
+
+    if (other) {
+        free_maps(maps);
+        s->maps = other;
+    }
+    set_slice_remap(s);
+    release_maps(&old);
+
     return 0;
 }
 
@@ -4239,7 +4605,7 @@ static void set_dimensions(int *outw, int *outh, int w, int h, const AVPixFmtDes
 }
 
 // Calculate remap data
-static av_always_inline int v360_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static int v360_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     V360Context *s = ctx->priv;
     SliceXYRemap *r = &s->slice_remap[jobnr];
@@ -4307,12 +4673,10 @@ static int config_output(AVFilterLink *outlink)
     V360Context *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     const int depth = desc->comp[0].depth;
-    const int sizeof_mask = s->mask_size = (depth + 7) >> 3;
     float default_h_fov = 360.f;
     float default_v_fov = 180.f;
     float default_ih_fov = 360.f;
     float default_iv_fov = 180.f;
-    int sizeof_uv;
     int sizeof_ker;
     int err;
     int h, w;
@@ -4323,62 +4687,55 @@ static int config_output(AVFilterLink *outlink)
     int have_alpha;
 
     s->max_value = (1 << depth) - 1;
+    s->mask_size = (depth + 7) >> 3;
 
     switch (s->interp) {
     case NEAREST:
         s->calculate_kernel = nearest_kernel;
         s->remap_slice = depth <= 8 ? remap1_8bit_slice : remap1_16bit_slice;
         s->elements = 1;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = 0;
         break;
     case BILINEAR:
         s->calculate_kernel = bilinear_kernel;
         s->remap_slice = depth <= 8 ? remap2_8bit_slice : remap2_16bit_slice;
         s->elements = 2 * 2;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case LAGRANGE9:
         s->calculate_kernel = lagrange_kernel;
         s->remap_slice = depth <= 8 ? remap3_8bit_slice : remap3_16bit_slice;
         s->elements = 3 * 3;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case BICUBIC:
         s->calculate_kernel = bicubic_kernel;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case LANCZOS:
         s->calculate_kernel = lanczos_kernel;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case SPLINE16:
         s->calculate_kernel = spline16_kernel;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case GAUSSIAN:
         s->calculate_kernel = gaussian_kernel;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     case MITCHELL:
         s->calculate_kernel = mitchell_kernel;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
-        sizeof_uv = sizeof(int16_t) * s->elements;
         sizeof_ker = sizeof(int16_t) * s->elements;
         break;
     default:
@@ -4889,20 +5246,12 @@ static int config_output(AVFilterLink *outlink)
     if (!s->slice_remap)
         return AVERROR(ENOMEM);
 
-    for (int i = 0; i < s->nb_allocated; i++) {
-        err = allocate_plane(s, sizeof_uv, sizeof_ker, sizeof_mask * have_alpha * s->alpha, i);
-        if (err < 0)
-            return err;
-    }
-
     calculate_rotation(s->yaw, s->pitch, s->roll,
                        s->rot_quaternion, s->rotation_order);
 
     set_mirror_modifier(s->h_flip, s->v_flip, s->d_flip, s->output_mirror_modifier);
 
-    ff_filter_execute(ctx, v360_slice, NULL, NULL, s->nb_threads);
-
-    return 0;
+    return get_maps(ctx, sizeof_ker > 0, have_alpha && s->alpha);
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
@@ -4969,18 +5318,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     V360Context *s = ctx->priv;
 
-    for (int n = 0; n < s->nb_threads && s->slice_remap; n++) {
-        SliceXYRemap *r = &s->slice_remap[n];
-
-        for (int p = 0; p < s->nb_allocated; p++) {
-            av_freep(&r->u[p]);
-            av_freep(&r->v[p]);
-            av_freep(&r->ker[p]);
-        }
-
-        av_freep(&r->mask);
-    }
-
+    release_maps(&s->maps);
     av_freep(&s->slice_remap);
 }
 
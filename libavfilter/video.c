@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include "libavutil/buffer.h"
+#include "libavutil/buffer_internal.h"
 #include "libavutil/cpu.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
@@ -63,7 +64,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     }
 
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+        link->frame_pool = ff_frame_pool_video_init(avpriv_buffer_shared_allocz, w, h,
                                                     link->format, align);
         if (!link->frame_pool)
             return NULL;
@@ -78,7 +79,7 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
             pool_format != link->format || pool_align != align) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+            link->frame_pool = ff_frame_pool_video_init(avpriv_buffer_shared_allocz, w, h,
                                                         link->format, align);
             if (!link->frame_pool)
                 return NULL;
@@ -1342,6 +1342,11 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+/**
+ * Let packets reference the input buffer instead of copying their data, for
+ * the demuxers supporting it. The padding of such packets is not zeroed.
+ */
+#define AVFMT_FLAG_ZERO_COPY  0x400000
 
     /**
      * Maximum number of bytes read from input in order to determine stream
@@ -2413,6 +2418,40 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt);
  */
 int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt);
 
+/**
+ * Write several packets to an output media file ensuring correct interleaving.
+ *
+ * With the default dts-based interleaving, all the packets are first added
+ * to the interleaving queue, and the queue is only drained once at the end
+ * of the call. Packets which av_interleaved_write_frame() would have written
+ * right away are thus only written then. Muxers with their own interleaving
+ * get the packets one at a time, as with av_interleaved_write_frame().
+ * In both cases, the output is flushed (AVFMT_FLAG_FLUSH_PACKETS) at most
+ * once per call, letting the I/O context coalesce the writes of consecutive
+ * packets.
+ *
+ * The output is the same as with av_interleaved_write_frame() called on each
+ * packet in turn as long as the packets are passed in dts order across
+ * streams. Otherwise, a packet may be written before packets with a higher
+ * dts passed earlier in the same call, which per-packet calls could already
+ * have written.
+ *
+ * @param s       media file handle
+ * @param pkts    array of nb_pkts packets, with the same requirements and
+ *                ownership semantics as for av_interleaved_write_frame().
+ *                All packets will be blank on return, even on error.
+ *                NULL entries are not allowed; use av_interleaved_write_frame()
+ *                to flush the interleaving queues.
+ * @param nb_pkts number of packets in pkts
+ *
+ * @return 0 on success, a negative AVERROR on error. On error, the packets
+ *         after the failing one are discarded, while those queued before it
+ *         are written by later calls or av_write_trailer().
+ *
+ * @see av_interleaved_write_frame()
+ */
+int av_interleaved_write_frames(AVFormatContext *s, AVPacket **pkts, int nb_pkts);
+
 /**
  * Write an uncoded frame to an output media file.
  *
@@ -58,6 +58,7 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"prefetch", "Number of buffers read ahead by a background thread", OFFSET(prefetch), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
     { NULL }
 };
 
@@ -303,6 +304,14 @@ int ffurl_alloc(URLContext **puc, const char *filename, int flags,
     return AVERROR_PROTOCOL_NOT_FOUND;
 }
 
+static int prefetch_interrupt_cb(void *opaque)
+{
+    URLContext *h = opaque;
+
+    return atomic_load(&h->prefetch_abort) ||
+           ff_check_interrupt(&h->prefetch_interrupt_callback);
+}
+
 int ffurl_open_whitelist(URLContext **puc, const char *filename, int flags,
                          const AVIOInterruptCB *int_cb, AVDictionary **options,
                          const char *whitelist, const char* blacklist,
@@ -344,6 +353,16 @@ int ffurl_open_whitelist(URLContext **puc, const char *filename, int flags,
     if ((ret = av_opt_set_dict(*puc, options)) < 0)
         goto fail;
 
+    /* Nested protocols copy the interrupt callback when they are opened,
+     * so it must be in place before connecting for the prefetch thread
+     * to be able to stop them. */
+    if ((*puc)->prefetch && !parent && !(flags & AVIO_FLAG_WRITE)) {
+        (*puc)->prefetch_interrupt_callback = (*puc)->interrupt_callback;
+        (*puc)->interrupt_callback.callback = prefetch_interrupt_cb;
+        (*puc)->interrupt_callback.opaque   = *puc;
+        atomic_init(&(*puc)->prefetch_abort, 0);
+    }
+
     ret = ffurl_connect(*puc, options);
 
     if (!ret)
@@ -22,6 +22,7 @@
 #include "avio.h"
 #include "url.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -77,6 +78,17 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Whether ffio_read_buffer_ref() may return references to the buffer
+     */
+    int buffer_refs;
+
+    /**
+     * Background reader filling buffers ahead of the demuxer, NULL if
+     * reads happen on demand
+     */
+    struct IOPrefetch *prefetch;
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -111,6 +123,32 @@ void ffio_init_context(FFIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Allow ffio_read_buffer_ref() to return references to the internal buffer
+ * of the AVIOContext. This only has an effect on read-only contexts opened
+ * by libavformat, i.e. not on user-supplied ones.
+ */
+void ffio_enable_buffer_refs(AVIOContext *s);
+
+/**
+ * Read size bytes from AVIOContext without copying them, by returning a
+ * reference to the part of the internal buffer holding them.
+ * This is only done if buffer references were enabled with
+ * ffio_enable_buffer_refs(), the requested data is already buffered and
+ * makes up a large enough part of the buffer. The buffer is then handed
+ * over to the returned reference, the AV_INPUT_BUFFER_PADDING_SIZE bytes
+ * following the data are zeroed, and the rest of the buffered data is
+ * copied to a new buffer.
+ *
+ * @param s IO context
+ * @param size number of bytes requested
+ * @param buf set to a new reference to the buffer on success
+ * @param data set to the start of the requested data in buf
+ * @return size on success, 0 if the data must be read with avio_read(),
+ *         a negative AVERROR code on failure
+ */
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -27,6 +27,8 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavcodec/defs.h"
 #include "avio.h"
 #include "avio_internal.h"
@@ -149,11 +151,312 @@ AVIOContext *avio_alloc_context(
     return &s->pub;
 }
 
+static void prefetch_uninit(AVIOContext *s);
+
 void avio_context_free(AVIOContext **ps)
 {
+    if (*ps)
+        prefetch_uninit(*ps);
     av_freep(ps);
 }
 
+#if HAVE_THREADS
+/**
+ * Ring of blocks filled by a background thread calling read_packet() ahead
+ * of the reader. The thread only ever touches the blocks which are not
+ * filled, and the protocol is only accessed from the caller while the
+ * thread is paused.
+ */
+typedef struct IOPrefetch {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    uint8_t *buf;
+    int *len;
+    int depth;
+    int block_size;
+
+    int rindex;             ///< block the reader consumes from
+    int roff;               ///< bytes of that block already consumed
+    int nb_filled;
+    int64_t pos;            ///< source position of the next byte handed out
+    int error;              ///< read error or EOF not returned to the reader yet
+
+    int busy;               ///< the thread is inside read_packet()
+    int paused;
+    int abort;
+
+    int64_t stall_time;
+    int nb_stalls;
+} IOPrefetch;
+
+static void *prefetch_thread(void *arg)
+{
+    AVIOContext *s = arg;
+    IOPrefetch *p  = ffiocontext(s)->prefetch;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        int idx, ret;
+
+        if (p->paused || p->error || p->nb_filled == p->depth) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+
+        idx     = (p->rindex + p->nb_filled) % p->depth;
+        p->busy = 1;
+        pthread_mutex_unlock(&p->mutex);
+
+        ret = s->read_packet(s->opaque, p->buf + idx * p->block_size, p->block_size);
+
+        pthread_mutex_lock(&p->mutex);
+        p->busy = 0;
+        if (ret == AVERROR_EXIT && p->paused) {
+            /* interrupted by prefetch_pause(), read again once resumed */
+        } else if (ret > 0) {
+            p->len[idx] = ret;
+            p->nb_filled++;
+        } else {
+            p->error = ret ? ret : AVERROR_EOF;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+static int prefetch_init(AVIOContext *s, int depth)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    IOPrefetch *p;
+    int ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->depth      = depth;
+    p->block_size = s->buffer_size;
+    p->pos        = s->pos;
+    p->buf        = av_malloc_array(depth, p->block_size);
+    p->len        = av_calloc(depth, sizeof(*p->len));
+    if (!p->buf || !p->len) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    ctx->prefetch = p;
+    if ((ret = pthread_create(&p->thread, NULL, prefetch_thread, s))) {
+        ctx->prefetch = NULL;
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    av_freep(&p->buf);
+    av_freep(&p->len);
+    av_freep(&p);
+    return ret;
+}
+
+static void prefetch_uninit(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    IOPrefetch *p = ctx->prefetch;
+    URLContext *h;
+
+    if (!p)
+        return;
+
+    /* make a blocking read_packet() in the thread return early */
+    h = ffio_geturlcontext(s);
+    if (h)
+        atomic_store(&h->prefetch_abort, 1);
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, NULL);
+
+    if (h)
+        atomic_store(&h->prefetch_abort, 0);
+
+    av_log(s, AV_LOG_VERBOSE, "Prefetch: %d stalls, %"PRId64" us stalled\n",
+           p->nb_stalls, p->stall_time);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->buf);
+    av_freep(&p->len);
+    av_freep(&ctx->prefetch);
+}
+
+static int prefetch_read(AVIOContext *s, uint8_t *buf, int size)
+{
+    IOPrefetch *p = ffiocontext(s)->prefetch;
+    const uint8_t *src;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    if (!p->nb_filled && !p->error && p->paused) {
+        /* avio_pause() stopped the thread, read directly */
+        pthread_mutex_unlock(&p->mutex);
+        ret = s->read_packet(s->opaque, buf, size);
+        if (ret > 0)
+            p->pos += ret;
+        return ret;
+    }
+    if (!p->nb_filled && !p->error) {
+        int64_t start = av_gettime_relative();
+        while (!p->nb_filled && !p->error)
+            pthread_cond_wait(&p->cond, &p->mutex);
+        p->stall_time += av_gettime_relative() - start;
+        p->nb_stalls++;
+    }
+    if (!p->nb_filled) {
+        ret      = p->error;
+        p->error = 0;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+        return ret;
+    }
+    src = p->buf + p->rindex * p->block_size + p->roff;
+    ret = FFMIN(size, p->len[p->rindex] - p->roff);
+    pthread_mutex_unlock(&p->mutex);
+
+    /* filled blocks are not touched by the thread */
+    memcpy(buf, src, ret);
+
+    pthread_mutex_lock(&p->mutex);
+    p->pos  += ret;
+    p->roff += ret;
+    if (p->roff == p->len[p->rindex]) {
+        p->roff   = 0;
+        p->rindex = (p->rindex + 1) % p->depth;
+        p->nb_filled--;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+/**
+ * Try to serve a seek from the data already read ahead.
+ * Must be called with the mutex held.
+ */
+static int prefetch_skip(IOPrefetch *p, int64_t offset)
+{
+    int64_t skip = offset - p->pos, avail = -p->roff;
+    int i;
+
+    for (i = 0; i < p->nb_filled; i++)
+        avail += p->len[(p->rindex + i) % p->depth];
+    if (skip < 0 || skip > avail)
+        return 0;
+
+    p->pos += skip;
+    while (skip) {
+        int n = FFMIN(skip, p->len[p->rindex] - p->roff);
+        skip    -= n;
+        p->roff += n;
+        if (p->roff == p->len[p->rindex]) {
+            p->roff   = 0;
+            p->rindex = (p->rindex + 1) % p->depth;
+            p->nb_filled--;
+        }
+    }
+    pthread_cond_broadcast(&p->cond);
+    return 1;
+}
+
+/**
+ * Wait until the thread no longer accesses the protocol. A read the thread
+ * is blocked in is interrupted, as the caller did not ask for that data.
+ */
+static void prefetch_pause(AVIOContext *s, IOPrefetch *p)
+{
+    URLContext *h = ffio_geturlcontext(s);
+
+    pthread_mutex_lock(&p->mutex);
+    p->paused = 1;
+    if (p->busy && h)
+        atomic_store(&h->prefetch_abort, 1);
+    while (p->busy)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    if (h)
+        atomic_store(&h->prefetch_abort, 0);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+/* Restart the thread, dropping the data read ahead if the source moved to pos. */
+static void prefetch_resume(IOPrefetch *p, int flush, int64_t pos)
+{
+    pthread_mutex_lock(&p->mutex);
+    if (flush) {
+        p->nb_filled = 0;
+        p->roff      = 0;
+        p->error     = 0;
+        p->pos       = pos;
+    }
+    p->paused = 0;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+#else
+static int prefetch_init(AVIOContext *s, int depth)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void prefetch_uninit(AVIOContext *s)
+{
+}
+#endif /* HAVE_THREADS */
+
+static int64_t seek_wrapper(AVIOContext *s, int64_t offset, int whence)
+{
+#if HAVE_THREADS
+    IOPrefetch *p = ffiocontext(s)->prefetch;
+
+    if (p) {
+        int64_t ret;
+
+        if (whence == SEEK_CUR) {
+            offset += p->pos;
+            whence  = SEEK_SET;
+        }
+        if (whence == SEEK_SET) {
+            pthread_mutex_lock(&p->mutex);
+            ret = prefetch_skip(p, offset);
+            pthread_mutex_unlock(&p->mutex);
+            if (ret)
+                return offset;
+        }
+
+        prefetch_pause(s, p);
+        ret = s->seek(s->opaque, offset, whence);
+        prefetch_resume(p, ret >= 0 && !(whence & AVSEEK_SIZE), ret);
+        return ret;
+    }
+#endif
+    return s->seek(s->opaque, offset, whence);
+}
+
 static void writeout(AVIOContext *s, const uint8_t *data, int len)
 {
     FFIOContext *const ctx = ffiocontext(s);
@@ -271,7 +574,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         return AVERROR(EINVAL);
 
     if ((whence & AVSEEK_SIZE))
-        return s->seek ? s->seek(s->opaque, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
+        return s->seek ? seek_wrapper(s, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
 
     buffer_size = s->buf_end - s->buffer;
     // pos is the absolute position that the beginning of s->buffer corresponds to in the file
@@ -317,7 +620,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         int64_t res;
 
         pos -= FFMIN(buffer_size>>1, pos);
-        if ((res = s->seek(s->opaque, pos, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, pos, SEEK_SET)) < 0)
             return res;
         s->buf_end =
         s->buf_ptr = s->buffer;
@@ -332,7 +635,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         }
         if (!s->seek)
             return AVERROR(EPIPE);
-        if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, offset, SEEK_SET)) < 0)
             return res;
         ctx->seek_count++;
         if (!s->write_flag)
@@ -362,12 +665,12 @@ int64_t avio_size(AVIOContext *s)
 
     if (!s->seek)
         return AVERROR(ENOSYS);
-    size = s->seek(s->opaque, 0, AVSEEK_SIZE);
+    size = seek_wrapper(s, 0, AVSEEK_SIZE);
     if (size < 0) {
-        if ((size = s->seek(s->opaque, -1, SEEK_END)) < 0)
+        if ((size = seek_wrapper(s, -1, SEEK_END)) < 0)
             return size;
         size++;
-        s->seek(s->opaque, s->pos, SEEK_SET);
+        seek_wrapper(s, s->pos, SEEK_SET);
     }
     return size;
 }
@@ -530,6 +833,10 @@ static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 
     if (!s->read_packet)
         return AVERROR(EINVAL);
+#if HAVE_THREADS
+    if (ffiocontext(s)->prefetch)
+        return prefetch_read(s, buf, size);
+#endif
     ret = s->read_packet(s->opaque, buf, size);
     av_assert2(ret || s->max_packet_size);
     return ret;
@@ -710,6 +1017,65 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+void ffio_enable_buffer_refs(AVIOContext *s)
+{
+    /* the buffer of user-supplied contexts is freed by the user */
+    if (!s->write_flag && ffio_geturlcontext(s))
+        ffiocontext(s)->buffer_refs = 1;
+}
+
+/* A reference keeps the whole buffer alive, so only packets of at least
+ * this fraction of the buffer size are read without copying. */
+#define BUFFER_REF_MIN_FRACTION 4
+
+int ffio_read_buffer_ref(AVIOContext *s, int size, AVBufferRef **buf, uint8_t **data)
+{
+    uint8_t *buffer, *end;
+    int left;
+
+    if (!ffiocontext(s)->buffer_refs || size <= 0 ||
+        (int64_t)size * BUFFER_REF_MIN_FRACTION < s->buffer_size)
+        return 0;
+
+    /* Refill an empty buffer as avio_read() would, instead of letting the
+     * packet be read past it. */
+    if (s->buf_ptr == s->buf_end && !s->direct && !s->write_flag &&
+        size <= s->buffer_size - AV_INPUT_BUFFER_PADDING_SIZE)
+        fill_buffer(s);
+    if (s->buf_end - s->buf_ptr < size)
+        return 0;
+
+    /* The packet keeps the current buffer and the data after it moves to a
+     * new one, so that the padding can be zeroed. This must fit into the
+     * buffer and cost less than copying the packet. */
+    end  = s->buf_ptr + size;
+    left = s->buf_end - end;
+    if (s->buffer + s->buffer_size - end < AV_INPUT_BUFFER_PADDING_SIZE ||
+        left > size)
+        return 0;
+
+    buffer = av_malloc(s->buffer_size);
+    if (!buffer)
+        return AVERROR(ENOMEM);
+    *buf = av_buffer_create(s->buffer, s->buffer_size,
+                            av_buffer_default_free, NULL, 0);
+    if (!*buf) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+    *data = s->buf_ptr;
+
+    if (s->update_checksum && end > s->checksum_ptr)
+        s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
+                                         end - s->checksum_ptr);
+    memcpy(buffer, end, left);
+    memset(end, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    s->buffer  = s->buf_ptr = s->checksum_ptr = buffer;
+    s->buf_end = buffer + left;
+    return size;
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -1006,6 +1372,12 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     }
     ((FFIOContext*)(*s))->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
     (*s)->av_class = &ff_avio_class;
+
+    if (h->prefetch && !(h->flags & AVIO_FLAG_WRITE) && !(*s)->direct && !max_packet_size) {
+        int ret = prefetch_init(*s, h->prefetch);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Could not start prefetching: %s\n", av_err2str(ret));
+    }
     return 0;
 }
 
@@ -1259,6 +1631,7 @@ int avio_close(AVIOContext *s)
         return 0;
 
     avio_flush(s);
+    prefetch_uninit(s);
     h         = s->opaque;
     s->opaque = NULL;
 
@@ -1316,17 +1689,39 @@ void avio_print_string_array(AVIOContext *s, const char *strings[])
 
 int avio_pause(AVIOContext *s, int pause)
 {
+#if HAVE_THREADS
+    IOPrefetch *p = ffiocontext(s)->prefetch;
+#endif
+    int ret;
+
     if (!s->read_pause)
         return AVERROR(ENOSYS);
-    return s->read_pause(s->opaque, pause);
+#if HAVE_THREADS
+    /* keep the thread from blocking in a read while the stream is paused */
+    if (p && pause)
+        prefetch_pause(s, p);
+#endif
+    ret = s->read_pause(s->opaque, pause);
+#if HAVE_THREADS
+    if (p && !pause)
+        prefetch_resume(p, 0, 0);
+#endif
+    return ret;
 }
 
 int64_t avio_seek_time(AVIOContext *s, int stream_index,
                        int64_t timestamp, int flags)
 {
+#if HAVE_THREADS
+    IOPrefetch *p = ffiocontext(s)->prefetch;
+#endif
     int64_t ret;
     if (!s->read_seek)
         return AVERROR(ENOSYS);
+#if HAVE_THREADS
+    if (p)
+        prefetch_pause(s, p);
+#endif
     ret = s->read_seek(s->opaque, stream_index, timestamp, flags);
     if (ret >= 0) {
         int64_t pos;
@@ -1337,6 +1732,10 @@ int64_t avio_seek_time(AVIOContext *s, int stream_index,
         else if (pos != AVERROR(ENOSYS))
             ret = pos;
     }
+#if HAVE_THREADS
+    if (p)
+        prefetch_resume(p, ret >= 0, s->pos);
+#endif
     return ret;
 }
 
@@ -241,6 +241,9 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
         goto fail;
     s->probe_score = ret;
 
+    if (s->pb && s->flags & AVFMT_FLAG_ZERO_COPY && !(s->flags & AVFMT_FLAG_CUSTOM_IO))
+        ffio_enable_buffer_refs(s->pb);
+
     if (!s->protocol_whitelist && s->pb && s->pb->protocol_whitelist) {
         s->protocol_whitelist = av_strdup(s->pb->protocol_whitelist);
         if (!s->protocol_whitelist) {
@@ -34,7 +34,13 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <stdlib.h>
+#if CONFIG_LIBURING
+#include <liburing.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,6 +73,17 @@
 
 /* standard file protocol */
 
+#define URING_BLOCK_SIZE (256 * 1024)
+
+typedef struct FileURingSlot {
+    uint8_t *buf;           ///< registered buffer of URING_BLOCK_SIZE bytes
+    int64_t pos;            ///< file offset of the request
+    int size;               ///< requested size
+    int written;            ///< bytes of a write already completed
+    int done;
+    int ret;                ///< result of the request once done
+} FileURingSlot;
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -74,16 +91,51 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
+    int readahead;
+    int64_t pos;            ///< current read position
+    int64_t run_start;      ///< position of the last seek
+    int random_access;      ///< access pattern currently advised
+#if HAVE_MMAP
+    uint8_t *map;
+    int64_t map_size;
+    long page_size;
+#endif
+    int use_uring;
+    int uring_depth;
+#if CONFIG_LIBURING
+    struct io_uring ring;
+    FileURingSlot *slots;
+    uint8_t *uring_buf;
+    int uring_active;
+    int uring_write;
+    int head;               ///< oldest queued slot
+    int nb_queued;          ///< slots with a request in flight or unconsumed data
+    int nb_unsubmitted;     ///< requests prepared but not submitted yet
+    int head_off;           ///< bytes of the head slot already returned
+    int64_t next_pos;       ///< file offset of the next read request
+    int uring_err;
+#endif
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
 } FileContext;
 
+enum FileAdvice {
+    ADVICE_SEQUENTIAL,
+    ADVICE_RANDOM,
+    ADVICE_WILLNEED,
+};
+
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Read the file through a memory mapping", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead", "set readahead window requested after seeks, -1 for auto", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Use io_uring for reads and writes", offsetof(FileContext, use_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "set number of io_uring requests kept in flight", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -106,17 +158,333 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+static void file_advise(FileContext *c, int64_t pos, int64_t len,
+                        enum FileAdvice advice)
+{
+#if HAVE_MMAP && HAVE_POSIX_MADVISE
+    if (c->map) {
+        static const int madv[] = { POSIX_MADV_SEQUENTIAL, POSIX_MADV_RANDOM, POSIX_MADV_WILLNEED };
+        int64_t start = pos & ~(int64_t)(c->page_size - 1);
+        int64_t end   = len ? FFMIN(pos + len, c->map_size) : c->map_size;
+
+        if (start < end)
+            posix_madvise(c->map + start, end - start, madv[advice]);
+        return;
+    }
+#endif
+#if HAVE_POSIX_FADVISE
+    {
+        static const int fadv[] = { POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED };
+        posix_fadvise(c->fd, pos, len, fadv[advice]);
+    }
+#endif
+}
+
+/**
+ * Switch the kernel readahead back to sequential once the demuxer has
+ * read a full window past its last seek.
+ */
+static void file_update_read_pattern(FileContext *c)
+{
+    if (c->random_access && c->pos - c->run_start >= c->readahead) {
+        file_advise(c, 0, 0, ADVICE_SEQUENTIAL);
+        c->random_access = 0;
+    }
+}
+
+/**
+ * Seeking away from the current position disables the sequential
+ * readahead and prefetches a window at the new position instead.
+ */
+static void file_update_seek_pattern(FileContext *c, int64_t pos)
+{
+    if (!c->readahead || pos == c->pos)
+        return;
+    if (!c->random_access) {
+        file_advise(c, 0, 0, ADVICE_RANDOM);
+        c->random_access = 1;
+    }
+    file_advise(c, pos, c->readahead, ADVICE_WILLNEED);
+    c->run_start = pos;
+}
+
+#if CONFIG_LIBURING
+static int uring_init(URLContext *h, int write)
+{
+    FileContext *c = h->priv_data;
+    struct iovec *iov;
+    int i, ret;
+
+    c->slots     = av_calloc(c->uring_depth, sizeof(*c->slots));
+    c->uring_buf = av_malloc_array(c->uring_depth, URING_BLOCK_SIZE);
+    iov          = av_calloc(c->uring_depth, sizeof(*iov));
+    if (!c->slots || !c->uring_buf || !iov) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* short writes are resubmitted, so allow one extra request per slot */
+    ret = io_uring_queue_init(2 * c->uring_depth, &c->ring, 0);
+    if (ret < 0) {
+        ret = AVERROR(-ret);
+        goto fail;
+    }
+
+    for (i = 0; i < c->uring_depth; i++) {
+        c->slots[i].buf = c->uring_buf + (size_t)i * URING_BLOCK_SIZE;
+        iov[i].iov_base = c->slots[i].buf;
+        iov[i].iov_len  = URING_BLOCK_SIZE;
+    }
+    ret = io_uring_register_buffers(&c->ring, iov, c->uring_depth);
+    if (ret >= 0)
+        ret = io_uring_register_files(&c->ring, &c->fd, 1);
+    if (ret < 0) {
+        io_uring_queue_exit(&c->ring);
+        ret = AVERROR(-ret);
+        goto fail;
+    }
+    av_free(iov);
+
+    c->uring_active = 1;
+    c->uring_write  = write;
+    return 0;
+fail:
+    av_free(iov);
+    av_freep(&c->slots);
+    av_freep(&c->uring_buf);
+    return ret;
+}
+
+/**
+ * Queue the request of a slot. If that fails, the slot is marked as done
+ * with the error, which is returned when the slot is waited for.
+ */
+static void uring_prep(FileContext *c, FileURingSlot *slot)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&c->ring);
+    uint8_t *buf = slot->buf + slot->written;
+    int size     = slot->size - slot->written;
+
+    if (!sqe) {
+        /* the ring has room for twice as many requests as there are slots,
+         * so submitting the pending ones must make room */
+        int ret = io_uring_submit(&c->ring);
+        if (ret >= 0) {
+            c->nb_unsubmitted = 0;
+            sqe = io_uring_get_sqe(&c->ring);
+        }
+        if (!sqe) {
+            slot->ret  = ret < 0 ? ret : -EBUSY;
+            slot->done = 1;
+            return;
+        }
+    }
+
+    if (c->uring_write)
+        io_uring_prep_write_fixed(sqe, 0, buf, size, slot->pos + slot->written, slot - c->slots);
+    else
+        io_uring_prep_read_fixed(sqe, 0, buf, size, slot->pos, slot - c->slots);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    io_uring_sqe_set_data(sqe, slot);
+    slot->done = 0;
+    c->nb_unsubmitted++;
+}
+
+/**
+ * Submit the prepared requests once half of the slots are waiting, so
+ * a single system call queues several of them.
+ */
+static int uring_submit(FileContext *c, int force)
+{
+    int ret;
+
+    if (!c->nb_unsubmitted || (!force && 2 * c->nb_unsubmitted < c->uring_depth))
+        return 0;
+    ret = io_uring_submit(&c->ring);
+    if (ret < 0)
+        return AVERROR(-ret);
+    c->nb_unsubmitted = 0;
+    return 0;
+}
+
+/**
+ * Wait until the given slot has completed, submitting all pending requests
+ * along the way.
+ */
+static int uring_wait(FileContext *c, FileURingSlot *wait_slot)
+{
+    struct io_uring_cqe *cqe;
+    int ret;
+
+    while (!wait_slot->done) {
+        ret = io_uring_submit_and_wait(&c->ring, 1);
+        if (ret < 0 && ret != -EINTR)
+            return AVERROR(-ret);
+        c->nb_unsubmitted = 0;
+
+        while (!io_uring_peek_cqe(&c->ring, &cqe)) {
+            FileURingSlot *slot = io_uring_cqe_get_data(cqe);
+            int res = cqe->res;
+
+            io_uring_cqe_seen(&c->ring, cqe);
+            if (c->uring_write && res > 0 && slot->written + res < slot->size) {
+                slot->written += res;
+                uring_prep(c, slot);
+                continue;
+            }
+            slot->ret  = res;
+            slot->done = 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Complete all queued requests, discarding read data. Returns the first
+ * write error.
+ */
+static int uring_drain(FileContext *c)
+{
+    int ret;
+
+    while (c->nb_queued) {
+        FileURingSlot *slot = &c->slots[c->head];
+        if ((ret = uring_wait(c, slot)) < 0)
+            return ret;
+        if (c->uring_write && slot->ret < 0 && !c->uring_err)
+            c->uring_err = AVERROR(-slot->ret);
+        c->head = (c->head + 1) % c->uring_depth;
+        c->nb_queued--;
+    }
+    c->head_off = 0;
+    return c->uring_err;
+}
+
+static void uring_queue_read(FileContext *c, FileURingSlot *slot)
+{
+    slot->pos     = c->next_pos;
+    slot->size    = URING_BLOCK_SIZE;
+    slot->written = 0;
+    uring_prep(c, slot);
+    c->next_pos  += URING_BLOCK_SIZE;
+}
+
+static int uring_read(FileContext *c, unsigned char *buf, int size)
+{
+    FileURingSlot *slot;
+    int i, ret;
+
+    if (!c->nb_queued) {
+        c->head     = 0;
+        c->next_pos = c->pos;
+        for (i = 0; i < c->uring_depth; i++)
+            uring_queue_read(c, &c->slots[i]);
+        c->nb_queued = c->uring_depth;
+    }
+
+    slot = &c->slots[c->head];
+    if ((ret = uring_wait(c, slot)) < 0)
+        return ret;
+    if (slot->ret <= 0) {
+        ret = slot->ret ? AVERROR(-slot->ret) : AVERROR_EOF;
+        uring_drain(c);
+        return ret;
+    }
+
+    size = FFMIN(size, slot->ret - c->head_off);
+    memcpy(buf, slot->buf + c->head_off, size);
+    c->head_off += size;
+    c->pos      += size;
+
+    if (c->head_off == slot->ret) {
+        if (slot->ret < slot->size) {
+            /* the following requests no longer start where this one ended */
+            uring_drain(c);
+        } else {
+            c->head_off = 0;
+            c->head     = (c->head + 1) % c->uring_depth;
+            uring_queue_read(c, slot);
+        }
+    }
+
+    if ((ret = uring_submit(c, 0)) < 0)
+        return ret;
+    return size;
+}
+
+static int uring_write(FileContext *c, const unsigned char *buf, int size)
+{
+    FileURingSlot *slot;
+    int ret;
+
+    if (c->uring_err)
+        return c->uring_err;
+
+    if (c->nb_queued == c->uring_depth) {
+        slot = &c->slots[c->head];
+        if ((ret = uring_wait(c, slot)) < 0)
+            return ret;
+        if (slot->ret < 0)
+            return c->uring_err = AVERROR(-slot->ret);
+        c->head = (c->head + 1) % c->uring_depth;
+        c->nb_queued--;
+    }
+
+    slot = &c->slots[(c->head + c->nb_queued) % c->uring_depth];
+    size = FFMIN(size, URING_BLOCK_SIZE);
+    memcpy(slot->buf, buf, size);
+    slot->pos     = c->pos;
+    slot->size    = size;
+    slot->written = 0;
+    uring_prep(c, slot);
+    c->nb_queued++;
+    c->pos += size;
+
+    if ((ret = uring_submit(c, 0)) < 0)
+        return ret;
+    return size;
+}
+
+static void uring_uninit(FileContext *c)
+{
+    io_uring_queue_exit(&c->ring);
+    av_freep(&c->slots);
+    av_freep(&c->uring_buf);
+    c->uring_active = 0;
+}
+#endif /* CONFIG_LIBURING */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if CONFIG_LIBURING
+    if (c->uring_active)
+        return uring_read(c, buf, size);
+#endif
+#if HAVE_MMAP
+    if (c->map) {
+        if (c->pos >= c->map_size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map_size - c->pos);
+        memcpy(buf, c->map + c->pos, size);
+        c->pos += size;
+        file_update_read_pattern(c);
+        return size;
+    }
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
     if (ret == 0)
         return AVERROR_EOF;
-    return (ret == -1) ? AVERROR(errno) : ret;
+    if (ret == -1)
+        return AVERROR(errno);
+    c->pos += ret;
+    if (c->readahead)
+        file_update_read_pattern(c);
+    return ret;
 }
 
 static int file_write(URLContext *h, const unsigned char *buf, int size)
@@ -124,6 +492,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if CONFIG_LIBURING
+    if (c->uring_active)
+        return uring_write(c, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -209,7 +581,7 @@ static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
     int access;
-    int fd;
+    int fd, ret;
     struct stat st;
 
     av_strstart(filename, "file:", &filename);
@@ -233,7 +605,44 @@ static int file_open(URLContext *h, const char *filename, int flags)
         return AVERROR(errno);
     c->fd = fd;
 
-    h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
+    ret = fstat(fd, &st);
+    h->is_streamed = !ret && S_ISFIFO(st.st_mode);
+
+    if (!ret && !(flags & AVIO_FLAG_WRITE) && !c->follow && S_ISREG(st.st_mode)) {
+#if HAVE_MMAP
+        if (c->use_mmap && st.st_size > 0 && (uint64_t)st.st_size <= SIZE_MAX) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                av_log(h, AV_LOG_WARNING, "Could not map file, using read(): %s\n",
+                       av_err2str(AVERROR(errno)));
+            } else {
+                c->map       = map;
+                c->map_size  = st.st_size;
+                c->page_size = sysconf(_SC_PAGESIZE);
+            }
+        }
+        if (c->readahead < 0)
+            c->readahead = c->map ? 1 << 20 : 0;
+#endif
+        if (c->readahead > 0)
+            file_advise(c, 0, 0, ADVICE_SEQUENTIAL);
+    }
+
+#if CONFIG_LIBURING
+    if (c->use_uring && !ret && S_ISREG(st.st_mode) && !c->follow &&
+        !(flags & AVIO_FLAG_READ && flags & AVIO_FLAG_WRITE)
+#if HAVE_MMAP
+        && !c->map
+#endif
+        ) {
+        int err = uring_init(h, !!(flags & AVIO_FLAG_WRITE));
+        if (err < 0)
+            av_log(h, AV_LOG_WARNING, "Could not set up io_uring, using %s(): %s\n",
+                   flags & AVIO_FLAG_WRITE ? "write" : "read", av_err2str(err));
+    }
+#endif
+    if (c->readahead < 0)
+        c->readahead = 0;
 
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
@@ -252,22 +661,77 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if CONFIG_LIBURING
+    if (c->uring_active && c->uring_write && (ret = uring_drain(c)) < 0)
+        return ret;
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_MMAP
+    if (c->map) {
+        switch (whence) {
+        case SEEK_SET:                     break;
+        case SEEK_CUR: pos += c->pos;      break;
+        case SEEK_END: pos += c->map_size; break;
+        default:       return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        file_update_seek_pattern(c, pos);
+        return c->pos = pos;
+    }
+#endif
+
+#if CONFIG_LIBURING
+    if (c->uring_active) {
+        struct stat st;
+        switch (whence) {
+        case SEEK_SET:                 break;
+        case SEEK_CUR: pos += c->pos;  break;
+        case SEEK_END:
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+            break;
+        default:       return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        if (pos != c->pos && (ret = uring_drain(c)) < 0)
+            return ret;
+        return c->pos = pos;
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
+    if (ret < 0)
+        return AVERROR(errno);
 
-    return ret < 0 ? AVERROR(errno) : ret;
+    file_update_seek_pattern(c, ret);
+    return c->pos = ret;
 }
 
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret, err = 0;
+#if CONFIG_LIBURING
+    if (c->uring_active) {
+        err = uring_drain(c);
+        uring_uninit(c);
+    }
+#endif
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
+    ret = close(c->fd);
+    return (ret == -1) ? AVERROR(errno) : err;
 }
 
 static int file_open_dir(URLContext *h)
@@ -99,6 +99,13 @@ typedef struct FFFormatContext {
     int (*interleave_packet)(struct AVFormatContext *s, AVPacket *pkt,
                              int flush, int has_packet);
 
+    /**
+     * Set while av_interleaved_write_frames() queues its packets;
+     * flushing the output is then deferred to the end of the call.
+     */
+    int batching;
+    int batch_flush;
+
     /**
      * This buffer is only needed when packets were already buffered but
      * not decoded, for example to get the codec parameters in MPEG
@@ -989,6 +996,14 @@ int ff_reshuffle_raw_rgb(AVFormatContext *s, AVPacket **ppkt, AVCodecParameters
  */
 int ff_get_packet_palette(AVFormatContext *s, AVPacket *pkt, int ret, uint32_t *palette);
 
+/**
+ * Same as av_get_packet(), but the packet may reference the buffer of the
+ * AVIOContext instead of holding a copy of the data, see
+ * ffio_read_buffer_ref(). The packet data must then not be modified in
+ * place, call av_packet_make_writable() first when needed.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 struct AVBPrint;
 /**
  * Finalize buf into extradata and set its size appropriately.
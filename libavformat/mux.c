@@ -754,7 +754,10 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (s->pb && ret >= 0) {
-        flush_if_needed(s);
+        if (si->batching)
+            si->batch_flush = 1;
+        else
+            flush_if_needed(s);
         if (s->pb->error < 0)
             ret = s->pb->error;
     }
@@ -1147,8 +1150,12 @@ static int write_packet_common(AVFormatContext *s, AVStream *st, AVPacket *pkt,
 #endif
 
     if (interleaved) {
+        FFFormatContext *const si = ffformatcontext(s);
         if (pkt->dts == AV_NOPTS_VALUE && !(s->oformat->flags & AVFMT_NOTIMESTAMPS))
             return AVERROR(EINVAL);
+        /* queue only, av_interleaved_write_frames() drains the queue once */
+        if (si->batching && si->interleave_packet == ff_interleave_packet_per_dts)
+            return ff_interleave_add_packet(s, pkt, interleave_compare_dts);
         return interleaved_write_packet(s, pkt, 0, 1);
     } else {
         return write_packet(s, pkt);
@@ -1275,6 +1282,33 @@ int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
     }
 }
 
+int av_interleaved_write_frames(AVFormatContext *s, AVPacket **pkts, int nb_pkts)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    int i, ret = 0;
+
+    si->batching    = 1;
+    si->batch_flush = 0;
+    for (i = 0; i < nb_pkts; i++) {
+        ret = write_packets_common(s, pkts[i], 1/*interleaved*/);
+        if (ret < 0)
+            break;
+    }
+    for (; i < nb_pkts; i++)
+        av_packet_unref(pkts[i]);
+
+    if (ret >= 0)
+        ret = interleaved_write_packet(s, si->parse_pkt, 0/*flush*/, 0);
+    si->batching = 0;
+
+    if (si->batch_flush) {
+        flush_if_needed(s);
+        if (ret >= 0 && s->pb->error < 0)
+            ret = s->pb->error;
+    }
+    return ret;
+}
+
 int av_write_trailer(AVFormatContext *s)
 {
     FFFormatContext *const si = ffformatcontext(s);
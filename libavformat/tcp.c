@@ -31,6 +31,9 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if CONFIG_LIBURING
+#include <liburing.h>
+#endif
 
 typedef struct TCPContext {
     const AVClass *class;
@@ -45,6 +48,11 @@ typedef struct TCPContext {
 #if !HAVE_WINSOCK2_H
     int tcp_mss;
 #endif /* !HAVE_WINSOCK2_H */
+    int use_uring;
+#if CONFIG_LIBURING
+    struct io_uring ring;
+    int uring_active;
+#endif
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -60,6 +68,7 @@ static const AVOption options[] = {
 #if !HAVE_WINSOCK2_H
     { "tcp_mss",     "Maximum segment size for outgoing TCP packets",          OFFSET(tcp_mss),     AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
 #endif /* !HAVE_WINSOCK2_H */
+    { "io_uring",    "Use io_uring for send and receive",                      OFFSET(use_uring),   AV_OPT_TYPE_BOOL, { .i64 = 0 },             0, 1, .flags = D|E },
     { NULL }
 };
 
@@ -206,6 +215,24 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     h->is_streamed = 1;
     s->fd = fd;
 
+#if CONFIG_LIBURING
+    if (s->use_uring && s->listen != 2) {
+        ret = io_uring_queue_init(4, &s->ring, 0);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Could not set up io_uring, using recv()/send(): %s\n",
+                   av_err2str(AVERROR(-ret)));
+        else
+            s->uring_active = 1;
+        /* io_uring waits for blocking sockets itself, while some kernels
+         * fail requests on nonblocking ones with EAGAIN */
+        if (s->uring_active && (ret = ff_socket_nonblock(fd, 0)) < 0) {
+            io_uring_queue_exit(&s->ring);
+            s->uring_active = 0;
+            ff_socket_nonblock(fd, 1);
+        }
+    }
+#endif
+
     freeaddrinfo(ai);
     return 0;
 
@@ -234,17 +261,106 @@ static int tcp_accept(URLContext *s, URLContext **c)
     return 0;
 }
 
+#if CONFIG_LIBURING
+/**
+ * Blocking send or receive through io_uring. The request is linked to a
+ * timeout of POLLING_TIME so the interrupt callback and rw_timeout are
+ * checked as often as with poll(), while a ready socket needs a single
+ * system call instead of poll() followed by recv()/send().
+ * The socket is in blocking mode while io_uring is used.
+ */
+static int tcp_uring_io(URLContext *h, uint8_t *buf, int size, int write)
+{
+    TCPContext *s = h->priv_data;
+    struct __kernel_timespec ts = { .tv_nsec = POLLING_TIME * 1000000LL };
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    int64_t wait_start = 0;
+    int i, ret, res;
+
+    while (1) {
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+
+        /* both requests are always submitted together, so the ring of 4
+         * entries has room for them unless something went badly wrong */
+        if (io_uring_sq_space_left(&s->ring) < 2)
+            return AVERROR_BUG;
+        sqe = io_uring_get_sqe(&s->ring);
+        if (!sqe)
+            return AVERROR_BUG;
+        if (write)
+            io_uring_prep_send(sqe, s->fd, buf, size, MSG_NOSIGNAL);
+        else
+            io_uring_prep_recv(sqe, s->fd, buf, size, 0);
+        io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+        io_uring_sqe_set_data(sqe, s);
+        sqe = io_uring_get_sqe(&s->ring);
+        if (!sqe)
+            return AVERROR_BUG;
+        io_uring_prep_link_timeout(sqe, &ts, 0);
+        io_uring_sqe_set_data(sqe, NULL);
+
+        ret = io_uring_submit_and_wait(&s->ring, 2);
+        if (ret < 0 && ret != -EINTR)
+            return AVERROR(-ret);
+
+        res = -ECANCELED;
+        for (i = 0; i < 2; ) {
+            ret = io_uring_wait_cqe(&s->ring, &cqe);
+            if (ret == -EINTR)
+                continue;
+            if (ret < 0)
+                return AVERROR(-ret);
+            if (io_uring_cqe_get_data(cqe))
+                res = cqe->res;
+            io_uring_cqe_seen(&s->ring, cqe);
+            i++;
+        }
+
+        if (res != -ECANCELED && res != -EINTR)
+            break;
+        if (h->rw_timeout > 0) {
+            if (!wait_start)
+                wait_start = av_gettime_relative();
+            else if (av_gettime_relative() - wait_start > h->rw_timeout)
+                return AVERROR(ETIMEDOUT);
+        }
+    }
+
+    if (res < 0)
+        return AVERROR(-res);
+    if (!res && !write)
+        return AVERROR_EOF;
+    return res;
+}
+#endif /* CONFIG_LIBURING */
+
+/* the socket is only nonblocking without io_uring */
+static int tcp_msg_flags(TCPContext *s)
+{
+#if CONFIG_LIBURING
+    if (s->uring_active)
+        return MSG_DONTWAIT;
+#endif
+    return 0;
+}
+
 static int tcp_read(URLContext *h, uint8_t *buf, int size)
 {
     TCPContext *s = h->priv_data;
     int ret;
 
+#if CONFIG_LIBURING
+    if (s->uring_active && !(h->flags & AVIO_FLAG_NONBLOCK))
+        return tcp_uring_io(h, buf, size, 0);
+#endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd_timeout(s->fd, 0, h->rw_timeout, &h->interrupt_callback);
         if (ret)
             return ret;
     }
-    ret = recv(s->fd, buf, size, 0);
+    ret = recv(s->fd, buf, size, tcp_msg_flags(s));
     if (ret == 0)
         return AVERROR_EOF;
     return ret < 0 ? ff_neterrno() : ret;
@@ -255,12 +371,16 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
     TCPContext *s = h->priv_data;
     int ret;
 
+#if CONFIG_LIBURING
+    if (s->uring_active && !(h->flags & AVIO_FLAG_NONBLOCK))
+        return tcp_uring_io(h, (uint8_t *)buf, size, 1);
+#endif
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
         if (ret)
             return ret;
     }
-    ret = send(s->fd, buf, size, MSG_NOSIGNAL);
+    ret = send(s->fd, buf, size, MSG_NOSIGNAL | tcp_msg_flags(s));
     return ret < 0 ? ff_neterrno() : ret;
 }
 
@@ -283,6 +403,10 @@ static int tcp_shutdown(URLContext *h, int flags)
 static int tcp_close(URLContext *h)
 {
     TCPContext *s = h->priv_data;
+#if CONFIG_LIBURING
+    if (s->uring_active)
+        io_uring_queue_exit(&s->ring);
+#endif
     closesocket(s->fd);
     return 0;
 }
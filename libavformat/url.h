@@ -24,6 +24,8 @@
 #ifndef AVFORMAT_URL_H
 #define AVFORMAT_URL_H
 
+#include <stdatomic.h>
+
 #include "avio.h"
 
 #include "libavutil/dict.h"
@@ -48,6 +50,13 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int prefetch;               /**< number of buffers read ahead by the AVIOContext, 0 to read on demand */
+    /**
+     * With prefetch, interrupt_callback is replaced by one which also
+     * returns true once prefetch_abort is set, calling this one otherwise.
+     */
+    AVIOInterruptCB prefetch_interrupt_callback;
+    atomic_int prefetch_abort;
 } URLContext;
 
 typedef struct URLProtocol {
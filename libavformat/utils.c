@@ -210,6 +210,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int ret;
+
+    av_packet_unref(pkt);
+    pkt->pos = avio_tell(s);
+
+    ret = ffio_read_buffer_ref(s, size, &pkt->buf, &pkt->data);
+    if (ret > 0)
+        pkt->size = ret;
+    if (ret)
+        return ret;
+
+    return append_packet_chunked(s, pkt, size);
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -74,18 +74,36 @@ void av_buffer_default_free(void *opaque, uint8_t *data)
     av_free(data);
 }
 
+/* Size of the AVBuffer placed in front of the data by av_buffer_alloc(),
+ * padded so that the data keeps the alignment of av_malloc(). */
+#define BUFFER_HEADER_SIZE FFALIGN(sizeof(AVBuffer), 64)
+
+static void buffer_header_free(void *opaque, uint8_t *data)
+{
+    av_free(data - BUFFER_HEADER_SIZE);
+}
+
 AVBufferRef *av_buffer_alloc(size_t size)
 {
-    AVBufferRef *ret = NULL;
-    uint8_t    *data = NULL;
+    AVBufferRef *ret;
+    AVBuffer *buf;
 
-    data = av_malloc(size);
-    if (!data)
+    /* allocate the AVBuffer and the data at once, they are freed together
+     * by buffer_header_free() */
+    if (size > SIZE_MAX - BUFFER_HEADER_SIZE)
         return NULL;
+    buf = av_malloc(BUFFER_HEADER_SIZE + size);
+    if (!buf)
+        return NULL;
+    memset(buf, 0, sizeof(*buf));
 
-    ret = av_buffer_create(data, size, av_buffer_default_free, NULL, 0);
-    if (!ret)
-        av_freep(&data);
+    ret = buffer_create(buf, (uint8_t *)buf + BUFFER_HEADER_SIZE, size,
+                        buffer_header_free, NULL, 0);
+    if (!ret) {
+        av_free(buf);
+        return NULL;
+    }
+    buf->flags_internal |= BUFFER_FLAG_NO_FREE;
 
     return ret;
 }
@@ -272,6 +290,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
     pool->alloc     = av_buffer_alloc; // fallback
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -288,19 +307,63 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
 }
 
+static void buffer_pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    uintptr_t head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+
+    do {
+        buf->next = (BufferPoolEntry *)head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, (uintptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+static BufferPoolEntry *buffer_pool_pop(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf, *rest, *tail;
+    uintptr_t head = 0;
+
+    buf = (BufferPoolEntry *)atomic_exchange_explicit(&pool->pool, 0,
+                                                      memory_order_acquire);
+    if (!buf || !buf->next)
+        return buf;
+
+    /* put the other entries back, along with the ones released meanwhile */
+    rest = buf->next;
+    while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head, (uintptr_t)rest,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {
+        BufferPoolEntry *released = (BufferPoolEntry *)
+            atomic_exchange_explicit(&pool->pool, 0, memory_order_acquire);
+        if (released) {
+            for (tail = released; tail->next; tail = tail->next);
+            tail->next = rest;
+            rest       = released;
+        }
+        head = 0;
+    }
+
+    buf->next = NULL;
+    return buf;
+}
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolEntry *buf = (BufferPoolEntry *)
+        atomic_exchange_explicit(&pool->pool, 0, memory_order_acquire);
+
+    while (buf) {
+        BufferPoolEntry *next = buf->next;
 
         buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+        av_free(buf);
+        buf = next;
     }
 }
 
@@ -328,9 +391,7 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
     pool   = *ppool;
     *ppool = NULL;
 
-    ff_mutex_lock(&pool->mutex);
     buffer_pool_flush(pool);
-    ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -344,10 +405,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    buffer_pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -389,21 +447,26 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = buffer_pool_pop(pool);
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
+        /* Pools with a fixed number of buffers fail to allocate when all of
+         * them are in use. The entries of a concurrent pop are put back
+         * shortly afterwards, try once more to get one of them. */
+        if (!ret)
+            buf = buffer_pool_pop(pool);
+    }
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (ret)
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        else
+            buffer_pool_push(pool, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -417,3 +480,176 @@ void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref)
     av_assert0(buf);
     return buf->opaque;
 }
+
+/* Buffers smaller than this are not worth sharing. */
+#define SHARED_MIN_SIZE    4096
+#define SHARED_MAX_CLASSES 64
+
+typedef struct SharedSizeClass {
+    size_t size;
+    /* cached buffers, each one storing the pointer to the next one */
+    uint8_t *free_list;
+} SharedSizeClass;
+
+static struct {
+    AVMutex mutex;
+    int active;
+    size_t max_cached;
+    SharedSizeClass classes[SHARED_MAX_CLASSES];
+    int nb_classes;
+    AVBufferPoolSharedStats stats;
+} shared = { .mutex = AV_MUTEX_INITIALIZER };
+
+/* Round the size up to one of 4 steps per power of two, wasting < 25%. */
+static size_t shared_class_size(size_t size)
+{
+    const size_t step = (size_t)1 << (av_log2(size - 1) - 2);
+
+    return FFALIGN(size, step);
+}
+
+static SharedSizeClass *shared_get_class(size_t size)
+{
+    for (int i = 0; i < shared.nb_classes; i++)
+        if (shared.classes[i].size == size)
+            return &shared.classes[i];
+    if (shared.nb_classes == SHARED_MAX_CLASSES)
+        return NULL;
+    shared.classes[shared.nb_classes].size      = size;
+    shared.classes[shared.nb_classes].free_list = NULL;
+    return &shared.classes[shared.nb_classes++];
+}
+
+static void shared_flush(size_t max_cached)
+{
+    for (int i = 0; i < shared.nb_classes && shared.stats.cached_size > max_cached; i++) {
+        SharedSizeClass *c = &shared.classes[i];
+        while (c->free_list && shared.stats.cached_size > max_cached) {
+            uint8_t *data = c->free_list;
+            memcpy(&c->free_list, data, sizeof(c->free_list));
+            av_free(data);
+            shared.stats.cached_size -= c->size;
+            shared.stats.nb_trimmed++;
+        }
+    }
+}
+
+static void shared_buffer_free(void *opaque, uint8_t *data)
+{
+    const size_t size = (uintptr_t)opaque;
+    SharedSizeClass *c = NULL;
+
+    ff_mutex_lock(&shared.mutex);
+    shared.stats.in_use_size -= size;
+    if (shared.active && shared.stats.cached_size + size <= shared.max_cached)
+        c = shared_get_class(size);
+    if (c) {
+        memcpy(data, &c->free_list, sizeof(c->free_list));
+        c->free_list = data;
+        shared.stats.cached_size += size;
+    } else {
+        shared.stats.nb_trimmed += shared.active;
+    }
+    ff_mutex_unlock(&shared.mutex);
+
+    if (!c)
+        av_free(data);
+}
+
+static AVBufferRef *shared_buffer_alloc(size_t size, int zero)
+{
+    SharedSizeClass *c = NULL;
+    AVBufferRef *ret;
+    uint8_t *data = NULL;
+    size_t class_size;
+
+    if (size < SHARED_MIN_SIZE)
+        return zero ? av_buffer_allocz(size) : av_buffer_alloc(size);
+    class_size = shared_class_size(size);
+
+    ff_mutex_lock(&shared.mutex);
+    if (!shared.active) {
+        ff_mutex_unlock(&shared.mutex);
+        return zero ? av_buffer_allocz(size) : av_buffer_alloc(size);
+    }
+    c = shared_get_class(class_size);
+    if (c && c->free_list) {
+        data = c->free_list;
+        memcpy(&c->free_list, data, sizeof(c->free_list));
+        shared.stats.cached_size -= class_size;
+        shared.stats.nb_hits++;
+    } else {
+        shared.stats.nb_misses++;
+    }
+    shared.stats.in_use_size += class_size;
+    ff_mutex_unlock(&shared.mutex);
+
+    if (!data) {
+        data = zero ? av_mallocz(class_size) : av_malloc(class_size);
+        if (!data) {
+            ff_mutex_lock(&shared.mutex);
+            shared.stats.in_use_size -= class_size;
+            ff_mutex_unlock(&shared.mutex);
+            return NULL;
+        }
+    } else if (zero) {
+        memset(data, 0, size);
+    }
+
+    ret = av_buffer_create(data, size, shared_buffer_free, (void *)(uintptr_t)class_size, 0);
+    if (!ret)
+        shared_buffer_free((void *)(uintptr_t)class_size, data);
+
+    return ret;
+}
+
+AVBufferRef *avpriv_buffer_shared_alloc(size_t size)
+{
+    return shared_buffer_alloc(size, 0);
+}
+
+AVBufferRef *avpriv_buffer_shared_allocz(size_t size)
+{
+    return shared_buffer_alloc(size, 1);
+}
+
+int av_buffer_pool_shared_init(size_t max_cached)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&shared.mutex);
+    if (shared.active) {
+        ret = AVERROR(EEXIST);
+    } else {
+        shared.active     = 1;
+        shared.max_cached = max_cached;
+    }
+    ff_mutex_unlock(&shared.mutex);
+
+    return ret;
+}
+
+void av_buffer_pool_shared_uninit(void)
+{
+    ff_mutex_lock(&shared.mutex);
+    shared.active = 0;
+    shared_flush(0);
+    shared.nb_classes = 0;
+    ff_mutex_unlock(&shared.mutex);
+}
+
+void av_buffer_pool_shared_trim(size_t max_cached)
+{
+    ff_mutex_lock(&shared.mutex);
+    shared_flush(max_cached);
+    if (shared.active)
+        shared.max_cached = max_cached;
+    ff_mutex_unlock(&shared.mutex);
+}
+
+void av_buffer_pool_shared_get_stats(AVBufferPoolSharedStats *stats)
+{
+    ff_mutex_lock(&shared.mutex);
+    *stats = shared.stats;
+    ff_mutex_unlock(&shared.mutex);
+}
@@ -315,6 +315,49 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
  */
 void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref);
 
+
+/**
+ * Statistics of the process-wide shared buffer pool.
+ */
+typedef struct AVBufferPoolSharedStats {
+    size_t   cached_size;  ///< bytes held by the pool, ready for reuse
+    size_t   in_use_size;  ///< bytes handed out and not yet returned
+    uint64_t nb_hits;      ///< allocations served from the cache
+    uint64_t nb_misses;    ///< allocations that had to allocate new memory
+    uint64_t nb_trimmed;   ///< buffers freed instead of being cached
+} AVBufferPoolSharedStats;
+
+/**
+ * Enable the process-wide shared buffer pool.
+ *
+ * Once enabled, the frame buffer pools of decoders and filter links allocate
+ * their buffers from the shared pool, and buffers released by them are kept
+ * in it for reuse by other instances. Buffers are cached per size class, a
+ * requested size being rounded up by at most 25%.
+ *
+ * @param max_cached maximum number of bytes kept cached in the pool; buffers
+ *                   released while the pool is full are freed
+ * @return 0 on success, AVERROR(EEXIST) if the pool was already enabled
+ */
+int av_buffer_pool_shared_init(size_t max_cached);
+
+/**
+ * Disable the shared buffer pool and free all the buffers cached in it.
+ * Buffers still in use are freed when released.
+ */
+void av_buffer_pool_shared_uninit(void);
+
+/**
+ * Free cached buffers until at most max_cached bytes are cached, and use
+ * max_cached as the new limit if the pool is enabled.
+ */
+void av_buffer_pool_shared_trim(size_t max_cached);
+
+/**
+ * Get the current statistics of the shared buffer pool.
+ */
+void av_buffer_pool_shared_get_stats(AVBufferPoolSharedStats *stats);
+
 /**
  * @}
  */
@@ -86,8 +86,19 @@ typedef struct BufferPoolEntry {
 } BufferPoolEntry;
 
 struct AVBufferPool {
+    /*
+     * Serializes the calls to the allocation callbacks, some of which
+     * manage a fixed set of buffers. It is not used to get cached entries.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /*
+     * Lock-free stack of the available entries, as a BufferPoolEntry pointer.
+     * Entries are only pushed one by one with compare-and-swap, while getting
+     * an entry takes the whole stack at once, so that no entry can be popped
+     * concurrently and the ABA problem cannot occur.
+     */
+    atomic_uintptr_t pool;
 
     /*
      * This is used to track when the pool is to be freed.
@@ -107,4 +118,16 @@ struct AVBufferPool {
     void         (*pool_free)(void *opaque);
 };
 
+/**
+ * Allocate a buffer from the process-wide shared pool, or with
+ * av_buffer_alloc() if it is not enabled. Meant to be used as the allocator
+ * of frame pools.
+ */
+AVBufferRef *avpriv_buffer_shared_alloc(size_t size);
+
+/**
+ * Same as avpriv_buffer_shared_alloc(), but zero the requested size.
+ */
+AVBufferRef *avpriv_buffer_shared_allocz(size_t size);
+
 #endif /* AVUTIL_BUFFER_INTERNAL_H */
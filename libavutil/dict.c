@@ -29,6 +29,7 @@
 
 struct AVDictionary {
     int count;
+    int nb_allocated;
     AVDictionaryEntry *elems;
 };
 
@@ -102,12 +103,15 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_free(tag->value);
         av_free(tag->key);
         *tag = m->elems[--m->count];
-    } else if (copy_value) {
+    } else if (copy_value && m->count == m->nb_allocated) {
+        /* grow geometrically, dictionaries are often filled entry by entry */
+        int nb_allocated = FFMAX(4, m->nb_allocated + (m->nb_allocated >> 1));
         AVDictionaryEntry *tmp = av_realloc_array(m->elems,
-                                                  m->count + 1, sizeof(*m->elems));
+                                                  nb_allocated, sizeof(*m->elems));
         if (!tmp)
             goto err_out;
-        m->elems = tmp;
+        m->elems        = tmp;
+        m->nb_allocated = nb_allocated;
     }
     if (copy_value) {
         m->elems[m->count].key = copy_key;
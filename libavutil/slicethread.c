@@ -22,10 +22,25 @@
 #include "slicethread.h"
 #include "mem.h"
 #include "thread.h"
+#include "threadpool.h"
 #include "avassert.h"
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+typedef struct SharedPool {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       *threads;
+    int             nb_threads;
+    int             nb_idle;    /* workers waiting for jobs */
+    int             refs;       /* contexts attached to the pool */
+    int             exit;
+    AVSliceThread   *pending;   /* contexts with jobs left to claim */
+} SharedPool;
+
+static AVMutex shared_pool_mutex = AV_MUTEX_INITIALIZER;
+static SharedPool *shared_pool;
+
 typedef struct WorkerContext {
     AVSliceThread   *ctx;
     pthread_mutex_t mutex;
@@ -50,6 +65,13 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* only used when running on the shared pool */
+    SharedPool      *pool;
+    int             priority;
+    int             nb_running; /* pool workers currently running jobs */
+    atomic_uint     jobs_done;
+    AVSliceThread   *next_pending;
 };
 
 static int run_jobs(AVSliceThread *ctx)
@@ -93,15 +115,271 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+/*
+ * In shared pool mode, job numbers and thread numbers are claimed separately:
+ * participants may join late or not at all when the pool is busy, so every
+ * participant keeps claiming jobs until none are left.
+ */
+static void run_shared_jobs(AVSliceThread *ctx, unsigned threadnr)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned jobnr;
+
+    while ((jobnr = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs) {
+        ctx->worker_func(ctx->priv, jobnr, threadnr, nb_jobs, ctx->nb_active_threads);
+        atomic_fetch_add_explicit(&ctx->jobs_done, 1, memory_order_acq_rel);
+    }
+}
+
+static int shared_ctx_claimable(AVSliceThread *ctx)
+{
+    return atomic_load_explicit(&ctx->first_job,   memory_order_acquire) < ctx->nb_active_threads &&
+           atomic_load_explicit(&ctx->current_job, memory_order_acquire) < ctx->nb_jobs;
+}
+
+static void remove_pending(SharedPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p;
+
+    for (p = &pool->pending; *p; p = &(*p)->next_pending) {
+        if (*p == ctx) {
+            *p = ctx->next_pending;
+            ctx->next_pending = NULL;
+            return;
+        }
+    }
+}
+
+/* must be called with pool->lock held */
+static AVSliceThread *pick_pending(SharedPool *pool)
+{
+    AVSliceThread **p = &pool->pending, *best = NULL;
+
+    while (*p) {
+        AVSliceThread *ctx = *p;
+
+        if (!shared_ctx_claimable(ctx)) {
+            *p = ctx->next_pending;
+            ctx->next_pending = NULL;
+            continue;
+        }
+        if (!best || ctx->priority > best->priority)
+            best = ctx;
+        p = &ctx->next_pending;
+    }
+
+    return best;
+}
+
+static void *attribute_align_arg pool_worker(void *v)
+{
+    SharedPool *pool = v;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->exit) {
+        AVSliceThread *ctx = pick_pending(pool);
+        unsigned threadnr;
+
+        if (!ctx) {
+            pool->nb_idle++;
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            pool->nb_idle--;
+            continue;
+        }
+
+        threadnr = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+        if (threadnr >= ctx->nb_active_threads)
+            continue;
+
+        ctx->nb_running++;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_shared_jobs(ctx, threadnr);
+
+        pthread_mutex_lock(&pool->lock);
+        if (!--ctx->nb_running)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void shared_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
+{
+    SharedPool *pool = ctx->pool;
+    int run_main = ctx->main_func && execute_main;
+    int jobs_first = 0;
+    unsigned threadnr;
+
+    ctx->nb_jobs           = nb_jobs;
+    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    atomic_store_explicit(&ctx->first_job,   0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+    atomic_store_explicit(&ctx->jobs_done,   0, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->lock);
+    if (ctx->nb_active_threads > 1 || run_main) {
+        AVSliceThread **p = &pool->pending;
+        while (*p)
+            p = &(*p)->next_pending;
+        *p = ctx;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    /* main_func may wait for the jobs, so it must not start before
+     * someone runs them: when no worker is idle, do it ourselves first. */
+    jobs_first = run_main && !pool->nb_idle;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (run_main && !jobs_first)
+        ctx->main_func(ctx->priv);
+
+    threadnr = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+    if (threadnr < ctx->nb_active_threads)
+        run_shared_jobs(ctx, threadnr);
+
+    if (jobs_first)
+        ctx->main_func(ctx->priv);
+
+    pthread_mutex_lock(&pool->lock);
+    remove_pending(pool, ctx);
+    while (ctx->nb_running ||
+           atomic_load_explicit(&ctx->jobs_done, memory_order_acquire) < nb_jobs)
+        pthread_cond_wait(&ctx->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void free_shared_pool(SharedPool *pool, int nb_threads)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->exit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+int av_thread_pool_init(int nb_threads)
+{
+    SharedPool *pool;
+    int i, ret = 0;
+
+    if (nb_threads < 0)
+        return AVERROR(EINVAL);
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    ff_mutex_lock(&shared_pool_mutex);
+    if (shared_pool) {
+        ret = AVERROR(EEXIST);
+        goto end;
+    }
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool || !(pool->threads = av_calloc(nb_threads, sizeof(*pool->threads)))) {
+        av_freep(&pool);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&pool->threads[i], NULL, pool_worker, pool))) {
+            free_shared_pool(pool, i);
+            ret = AVERROR(ret);
+            goto end;
+        }
+    }
+    pool->nb_threads = nb_threads;
+    shared_pool = pool;
+
+end:
+    ff_mutex_unlock(&shared_pool_mutex);
+    return ret;
+}
+
+int av_thread_pool_uninit(void)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&shared_pool_mutex);
+    if (shared_pool && shared_pool->refs) {
+        ret = AVERROR(EBUSY);
+    } else if (shared_pool) {
+        free_shared_pool(shared_pool, shared_pool->nb_threads);
+        shared_pool = NULL;
+    }
+    ff_mutex_unlock(&shared_pool_mutex);
+
+    return ret;
+}
+
+static int create_shared(AVSliceThread **pctx, void *priv,
+                         void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                         void (*main_func)(void *priv),
+                         int nb_threads)
+{
+    AVSliceThread *ctx;
+    SharedPool *pool;
+    int max_threads;
+
+    ff_mutex_lock(&shared_pool_mutex);
+    pool = shared_pool;
+    if (pool)
+        pool->refs++;
+    ff_mutex_unlock(&shared_pool_mutex);
+    if (!pool)
+        return 0;
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx) {
+        ff_mutex_lock(&shared_pool_mutex);
+        pool->refs--;
+        ff_mutex_unlock(&shared_pool_mutex);
+        return AVERROR(ENOMEM);
+    }
+
+    /* the calling thread runs jobs too, unless it is busy with main_func */
+    max_threads = pool->nb_threads + !main_func;
+    nb_threads  = nb_threads ? FFMIN(nb_threads, max_threads) : max_threads;
+
+    ctx->pool        = pool;
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->main_func   = main_func;
+    ctx->nb_threads  = nb_threads;
+
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+    atomic_init(&ctx->jobs_done, 0);
+    pthread_cond_init(&ctx->done_cond, NULL);
+
+    return nb_threads;
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
                               int nb_threads)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
+    int nb_workers, i, ret;
 
     av_assert0(nb_threads >= 0);
+    if (nb_threads != 1) {
+        ret = create_shared(pctx, priv, worker_func, main_func, nb_threads);
+        if (ret)
+            return ret;
+    }
     if (!nb_threads) {
         int nb_cpus = av_cpu_count();
         if (nb_cpus > 1)
@@ -139,7 +417,6 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
 
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
-        int ret;
         w->ctx = ctx;
         pthread_mutex_init(&w->mutex, NULL);
         pthread_cond_init(&w->cond, NULL);
@@ -168,6 +445,11 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+    if (ctx->pool) {
+        shared_execute(ctx, nb_jobs, execute_main);
+        return;
+    }
+
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
@@ -207,6 +489,15 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->pool) {
+        ff_mutex_lock(&shared_pool_mutex);
+        ctx->pool->refs--;
+        ff_mutex_unlock(&shared_pool_mutex);
+        pthread_cond_destroy(&ctx->done_cond);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -233,8 +524,27 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     av_freep(pctx);
 }
 
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority)
+{
+    ctx->priority = priority;
+}
+
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
+int av_thread_pool_init(int nb_threads)
+{
+    return AVERROR(ENOSYS);
+}
+
+int av_thread_pool_uninit(void)
+{
+    return 0;
+}
+
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority)
+{
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -43,6 +43,24 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Job priorities of the different users of slice threading, used when
+ * running on the shared thread pool (see av_thread_pool_init()).
+ */
+enum {
+    AVPRIV_SLICETHREAD_PRIORITY_FILTER,
+    AVPRIV_SLICETHREAD_PRIORITY_SCALE,
+    AVPRIV_SLICETHREAD_PRIORITY_CODEC,
+};
+
+/**
+ * Set the priority of the jobs of this context on the shared thread pool.
+ * Has no effect when the context has its own threads.
+ * @param ctx slice threading context
+ * @param priority one of AVPRIV_SLICETHREAD_PRIORITY_*, higher runs first
+ */
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
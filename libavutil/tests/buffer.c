@@ -0,0 +1,244 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/buffer_internal.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define NB_BUFS 4
+
+static void print_stats(const char *step)
+{
+    AVBufferPoolSharedStats st;
+
+    av_buffer_pool_shared_get_stats(&st);
+    printf("%-10s cached %7zu in use %7zu hits %2"PRIu64" misses %2"PRIu64" trimmed %2"PRIu64"\n",
+           step, st.cached_size, st.in_use_size, st.nb_hits, st.nb_misses, st.nb_trimmed);
+}
+
+/* get NB_BUFS buffers from a private pool backed by the shared one */
+static int run_pool(size_t size)
+{
+    AVBufferPool *pool = av_buffer_pool_init(size, avpriv_buffer_shared_allocz);
+    AVBufferRef *bufs[NB_BUFS] = { NULL };
+    int i, ret = 0;
+
+    if (!pool)
+        return -1;
+    for (i = 0; i < NB_BUFS; i++) {
+        bufs[i] = av_buffer_pool_get(pool);
+        if (!bufs[i] || bufs[i]->size != size) {
+            ret = -1;
+            break;
+        }
+        for (size_t j = 0; j < size; j++)
+            if (bufs[i]->data[j])
+                ret = -1;
+        memset(bufs[i]->data, 0xff, size);
+    }
+    for (i = 0; i < NB_BUFS; i++)
+        av_buffer_unref(&bufs[i]);
+    av_buffer_pool_uninit(&pool);
+    return ret;
+}
+
+#if HAVE_THREADS
+#define MAX_THREADS  64
+#define BENCH_OPS    (1 << 22)
+
+typedef struct ThreadContext {
+    AVBufferPool *pool;
+    pthread_t thread;
+    int id;
+    int nb_iters;
+    int errors;
+} ThreadContext;
+
+static atomic_int nb_allocated;
+
+static AVBufferRef *count_alloc(void *opaque, size_t size)
+{
+    atomic_fetch_add(&nb_allocated, 1);
+    return av_buffer_alloc(size);
+}
+
+/* get and release a few buffers at a time, checking that no other thread
+ * gets them while they are in use */
+static void *pool_thread(void *arg)
+{
+    ThreadContext *c = arg;
+    AVBufferRef *bufs[3];
+
+    for (int i = 0; i < c->nb_iters; i++) {
+        const int nb = i % 3 + 1;
+        for (int j = 0; j < nb; j++) {
+            bufs[j] = av_buffer_pool_get(c->pool);
+            if (!bufs[j]) {
+                c->errors++;
+                return NULL;
+            }
+            memcpy(bufs[j]->data, &c->id, sizeof(c->id));
+        }
+        for (int j = 0; j < nb; j++) {
+            if (memcmp(bufs[j]->data, &c->id, sizeof(c->id)))
+                c->errors++;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+    return NULL;
+}
+
+static int run_threads(int nb_threads, int nb_iters, int64_t *time)
+{
+    ThreadContext c[MAX_THREADS];
+    AVBufferPool *pool;
+    int64_t start;
+    int i, errors = 0;
+
+    atomic_store(&nb_allocated, 0);
+    pool = av_buffer_pool_init2(64, NULL, count_alloc, NULL);
+    if (!pool)
+        return 1;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_threads; i++) {
+        c[i] = (ThreadContext){ .pool = pool, .id = i, .nb_iters = nb_iters };
+        if (pthread_create(&c[i].thread, NULL, pool_thread, &c[i])) {
+            errors++;
+            break;
+        }
+    }
+    while (--i >= 0) {
+        pthread_join(c[i].thread, NULL);
+        errors += c[i].errors;
+    }
+    *time = av_gettime_relative() - start;
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+/* measure the cost of a get/release pair with 1 to 64 threads sharing a pool */
+static int bench(void)
+{
+    int errors = 0;
+
+    for (int nb_threads = 1; nb_threads <= MAX_THREADS; nb_threads *= 2) {
+        int64_t time;
+        /* 2 get/release pairs per iteration on average */
+        int nb_iters = BENCH_OPS / 2 / nb_threads;
+
+        errors += run_threads(nb_threads, nb_iters, &time);
+        printf("%2d threads: %7.1f ns per get/release, %3d buffers allocated\n",
+               nb_threads, time * 1000.0 / BENCH_OPS, atomic_load(&nb_allocated));
+    }
+    return errors;
+}
+#endif
+
+/* buffers from av_buffer_alloc() share their allocation with the AVBuffer */
+static int test_alloc(void)
+{
+    AVBufferRef *buf = av_buffer_allocz(1000), *ref;
+    int ret = 0;
+
+    if (!buf)
+        return -1;
+    if ((uintptr_t)buf->data & 15 || buf->size != 1000 || buf->data[999])
+        ret = -1;
+    memset(buf->data, 0x42, buf->size);
+    ref = av_buffer_ref(buf);
+    if (!ref || av_buffer_make_writable(&buf) < 0 || buf->data[0] != 0x42)
+        ret = -1;
+    av_buffer_unref(&ref);
+    if (av_buffer_realloc(&buf, 100000) < 0 || buf->data[999] != 0x42)
+        ret = -1;
+    av_buffer_unref(&buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    AVBufferRef *buf;
+    int ret = 0;
+
+#if HAVE_THREADS
+    if (argc > 1 && !strcmp(argv[1], "-b"))
+        return !!bench();
+#endif
+
+    ret |= test_alloc();
+
+    /* inactive: plain allocations, no accounting */
+    ret |= run_pool(100000);
+    print_stats("inactive");
+
+    if (av_buffer_pool_shared_init(1 << 20) < 0 ||
+        av_buffer_pool_shared_init(1 << 20) != AVERROR(EEXIST))
+        ret = -1;
+
+    /* the first pool misses, the second one reuses its buffers */
+    ret |= run_pool(100000);
+    print_stats("first");
+    ret |= run_pool(100000);
+    print_stats("second");
+
+    /* a slightly smaller size maps to the same size class */
+    ret |= run_pool(99000);
+    print_stats("same class");
+
+    /* small buffers bypass the pool */
+    buf = avpriv_buffer_shared_alloc(100);
+    if (!buf)
+        ret = -1;
+    av_buffer_unref(&buf);
+    print_stats("small");
+
+    /* too large to be cached entirely */
+    ret |= run_pool(300000);
+    print_stats("watermark");
+
+    av_buffer_pool_shared_trim(0);
+    print_stats("trim");
+
+    ret |= run_pool(100000);
+    buf = avpriv_buffer_shared_alloc(100000);
+    av_buffer_pool_shared_uninit();
+    print_stats("uninit");
+    av_buffer_unref(&buf);
+    print_stats("released");
+
+#if HAVE_THREADS
+    {
+        int64_t time;
+        if (run_threads(8, 10000, &time))
+            ret = -1;
+    }
+#endif
+
+    if (ret)
+        printf("error\n");
+    return !!ret;
+}
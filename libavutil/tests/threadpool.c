@@ -0,0 +1,182 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+/*
+ * This test program runs slice jobs from several threads at once on the
+ * shared thread pool and checks that every job runs exactly once with a
+ * valid thread number. Half of the callers use a main function that waits
+ * for all their jobs, which must also work when every pool worker is stuck
+ * on another context.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadpool.h"
+
+#define NB_CALLERS   4
+#define NB_JOBS      37
+#define NB_EXECUTES  100
+#define NB_POOL_THREADS 3
+
+typedef struct TestContext {
+    AVSliceThread *thread;
+    int nb_threads;
+    int job_count[NB_JOBS];
+    int errors;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int jobs_done;
+} TestContext;
+
+/* used to keep all pool workers busy until released */
+static pthread_mutex_t block_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t block_cond  = PTHREAD_COND_INITIALIZER;
+static int nb_blocked, released;
+
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    TestContext *c = priv;
+
+    if (threadnr < 0 || threadnr >= nb_threads || nb_threads > c->nb_threads)
+        c->errors++;
+    c->job_count[jobnr]++;
+
+    pthread_mutex_lock(&c->lock);
+    c->jobs_done++;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* waits for the jobs, like a decoder filtering the rows its jobs decoded */
+static void main_func(void *priv)
+{
+    TestContext *c = priv;
+
+    pthread_mutex_lock(&c->lock);
+    while (c->jobs_done < NB_JOBS)
+        pthread_cond_wait(&c->cond, &c->lock);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void block_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    pthread_mutex_lock(&block_lock);
+    nb_blocked++;
+    pthread_cond_broadcast(&block_cond);
+    while (!released)
+        pthread_cond_wait(&block_cond, &block_lock);
+    pthread_mutex_unlock(&block_lock);
+}
+
+static void *block_main(void *arg)
+{
+    avpriv_slicethread_execute(arg, NB_POOL_THREADS + 1, 0);
+    return NULL;
+}
+
+static void *thread_main(void *arg)
+{
+    TestContext *c = arg;
+    int i, j;
+
+    for (i = 0; i < NB_EXECUTES; i++) {
+        memset(c->job_count, 0, sizeof(c->job_count));
+        c->jobs_done = 0;
+        avpriv_slicethread_execute(c->thread, NB_JOBS, 1);
+        for (j = 0; j < NB_JOBS; j++)
+            if (c->job_count[j] != 1)
+                c->errors++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    TestContext ctx[NB_CALLERS] = { { 0 } };
+    pthread_t threads[NB_CALLERS], block_thread;
+    AVSliceThread *block;
+    int i, ret, errors = 0;
+
+    if ((ret = av_thread_pool_init(NB_POOL_THREADS)) < 0) {
+        fprintf(stderr, "av_thread_pool_init failed\n");
+        return 1;
+    }
+
+    for (i = 0; i < NB_CALLERS; i++) {
+        pthread_mutex_init(&ctx[i].lock, NULL);
+        pthread_cond_init(&ctx[i].cond, NULL);
+        ret = avpriv_slicethread_create(&ctx[i].thread, &ctx[i], worker_func,
+                                        i & 1 ? main_func : NULL, 0);
+        if (ret < 0) {
+            fprintf(stderr, "avpriv_slicethread_create failed\n");
+            return 1;
+        }
+        ctx[i].nb_threads = ret;
+        avpriv_slicethread_set_priority(ctx[i].thread, i & 1);
+    }
+
+    if (av_thread_pool_uninit() != AVERROR(EBUSY))
+        return 2;
+
+    /* occupy every pool worker, then run a context with a main function */
+    if (avpriv_slicethread_create(&block, NULL, block_func, NULL, 0) != NB_POOL_THREADS + 1 ||
+        pthread_create(&block_thread, NULL, block_main, block)) {
+        fprintf(stderr, "failed to block the pool\n");
+        return 1;
+    }
+    pthread_mutex_lock(&block_lock);
+    while (nb_blocked < NB_POOL_THREADS + 1)
+        pthread_cond_wait(&block_cond, &block_lock);
+    pthread_mutex_unlock(&block_lock);
+
+    memset(ctx[1].job_count, 0, sizeof(ctx[1].job_count));
+    avpriv_slicethread_execute(ctx[1].thread, NB_JOBS, 1);
+    for (i = 0; i < NB_JOBS; i++)
+        if (ctx[1].job_count[i] != 1)
+            errors++;
+
+    pthread_mutex_lock(&block_lock);
+    released = 1;
+    pthread_cond_broadcast(&block_cond);
+    pthread_mutex_unlock(&block_lock);
+    pthread_join(block_thread, NULL);
+    avpriv_slicethread_free(&block);
+
+    for (i = 0; i < NB_CALLERS; i++) {
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &ctx[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (i = 0; i < NB_CALLERS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += ctx[i].errors;
+        avpriv_slicethread_free(&ctx[i].thread);
+        pthread_cond_destroy(&ctx[i].cond);
+        pthread_mutex_destroy(&ctx[i].lock);
+    }
+
+    if (av_thread_pool_uninit() < 0)
+        return 2;
+
+    return !!errors * 3;
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_THREADPOOL_H
+#define AVUTIL_THREADPOOL_H
+
+/**
+ * @file
+ * @ingroup lavu_threadpool
+ * Process-wide thread pool shared by the FFmpeg libraries.
+ */
+
+/**
+ * @defgroup lavu_threadpool Shared thread pool
+ * @ingroup lavu_misc
+ *
+ * By default every codec, filtergraph and scaler context using slice
+ * threading creates its own worker threads, so a process running many of
+ * them at once ends up with far more threads than CPU cores. Once a shared
+ * pool has been created, all slice threading contexts created afterwards
+ * submit their jobs to it instead. Idle workers pick up the pending jobs
+ * of any context, preferring codec jobs over scaling and filtering ones.
+ *
+ * Frame threading in libavcodec is not affected.
+ *
+ * @{
+ */
+
+/**
+ * Create the process-wide thread pool.
+ *
+ * @param nb_threads number of worker threads, 0 for one per CPU core
+ * @return 0 on success, AVERROR(EEXIST) if the pool already exists,
+ *         another negative AVERROR code on failure
+ */
+int av_thread_pool_init(int nb_threads);
+
+/**
+ * Destroy the process-wide thread pool.
+ *
+ * @return 0 on success, AVERROR(EBUSY) if contexts created while the pool
+ *         existed are still alive
+ */
+int av_thread_pool_uninit(void);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_THREADPOOL_H */
@@ -191,7 +191,7 @@ av_cold void ff_get_unscaled_swscale_ppc(SwsContext *c)
         return;
 
     if (!(c->srcW & 15) && !(c->flags & SWS_BITEXACT) &&
-        c->srcFormat == AV_PIX_FMT_YUV420P) {
+        c->srcFormat == AV_PIX_FMT_YUV420P && c->srcRange == c->dstRange) {
         enum AVPixelFormat dstFormat = c->dstFormat;
 
         // unscaled YV12 -> packed YUV, we want speed
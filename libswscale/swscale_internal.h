@@ -674,6 +674,10 @@ typedef struct SwsContext {
     unsigned int dst_slice_align;
     atomic_int   stride_unaligned_warned;
     atomic_int   data_unaligned_warned;
+
+    // range conversion tables of the generic unscaled converter
+    // for luma and chroma, indexed by the source value
+    uint16_t *unscaled_range_lut[2];
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -1971,6 +1971,302 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t *src[],
      (src_fmt == pix_fmt ## LE && dst_fmt == pix_fmt ## BE))
 
 
+/*
+ * Generic unscaled converter between any two integer YUV layouts with
+ * the same chroma subsampling, e.g. P010 <-> YUV420P10 or NV16 <-> YUYV422.
+ * Every output component is produced in a single pass over its source
+ * component, using a line function picked from a table by the sample
+ * sizes and endianness of both formats, and a shift or, for range
+ * conversions, a lookup table indexed by the source value.
+ */
+
+enum {
+    GENERIC_COMP_Y,
+    GENERIC_COMP_U,
+    GENERIC_COMP_V,
+    GENERIC_COMP_A,
+};
+
+typedef struct GenericComp {
+    int src_step, src_shift;
+    unsigned src_mask;
+    int dst_step, dst_shift;
+    int lshift, rshift;
+    int rep_shift;          ///< low bits refill shift when scaling up full range values
+    unsigned rep_mask;
+    unsigned max;
+    const uint16_t *lut;
+} GenericComp;
+
+typedef void (*generic_line_fn)(uint8_t *dst, const uint8_t *src, int width,
+                                const GenericComp *p);
+
+static av_always_inline unsigned generic_read(const uint8_t *p, int bytes, int be)
+{
+    if (bytes == 1)
+        return *p;
+    return be ? AV_RB16(p) : AV_RL16(p);
+}
+
+static av_always_inline void generic_write(uint8_t *p, unsigned v, int bytes, int be)
+{
+    if (bytes == 1)
+        *p = v;
+    else if (be)
+        AV_WB16(p, v);
+    else
+        AV_WL16(p, v);
+}
+
+static av_always_inline void generic_line(uint8_t *dst, const uint8_t *src,
+                                          int width, const GenericComp *p,
+                                          int src_bytes, int src_be,
+                                          int dst_bytes, int dst_be, int use_lut)
+{
+    const int rnd = p->rshift ? 1 << (p->rshift - 1) : 0;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        unsigned v = generic_read(src + x * p->src_step, src_bytes, src_be);
+        v = (v >> p->src_shift) & p->src_mask;
+        if (use_lut)
+            v = p->lut[v];
+        else
+            v = FFMIN(((v << p->lshift | (v >> p->rep_shift & p->rep_mask)) + rnd) >> p->rshift, p->max);
+        generic_write(dst + x * p->dst_step, v << p->dst_shift, dst_bytes, dst_be);
+    }
+}
+
+#define GENERIC_LINE_FN(name, sb, sbe, db, dbe)                                \
+static void generic_line_ ## name(uint8_t *dst, const uint8_t *src,           \
+                                  int width, const GenericComp *p)            \
+{                                                                             \
+    generic_line(dst, src, width, p, sb, sbe, db, dbe, 0);                    \
+}                                                                             \
+static void generic_line_ ## name ## _lut(uint8_t *dst, const uint8_t *src,   \
+                                          int width, const GenericComp *p)    \
+{                                                                             \
+    generic_line(dst, src, width, p, sb, sbe, db, dbe, 1);                    \
+}
+
+GENERIC_LINE_FN(8_8,       1, 0, 1, 0)
+GENERIC_LINE_FN(8_16le,    1, 0, 2, 0)
+GENERIC_LINE_FN(8_16be,    1, 0, 2, 1)
+GENERIC_LINE_FN(16le_8,    2, 0, 1, 0)
+GENERIC_LINE_FN(16le_16le, 2, 0, 2, 0)
+GENERIC_LINE_FN(16le_16be, 2, 0, 2, 1)
+GENERIC_LINE_FN(16be_8,    2, 1, 1, 0)
+GENERIC_LINE_FN(16be_16le, 2, 1, 2, 0)
+GENERIC_LINE_FN(16be_16be, 2, 1, 2, 1)
+
+/* indexed by [use_lut][src layout][dst layout], layouts are 8, 16le, 16be */
+static const generic_line_fn generic_line_fns[2][3][3] = {
+    { { generic_line_8_8,        generic_line_8_16le,        generic_line_8_16be        },
+      { generic_line_16le_8,     generic_line_16le_16le,     generic_line_16le_16be     },
+      { generic_line_16be_8,     generic_line_16be_16le,     generic_line_16be_16be     } },
+    { { generic_line_8_8_lut,    generic_line_8_16le_lut,    generic_line_8_16be_lut    },
+      { generic_line_16le_8_lut, generic_line_16le_16le_lut, generic_line_16le_16be_lut },
+      { generic_line_16be_8_lut, generic_line_16be_16le_lut, generic_line_16be_16be_lut } },
+};
+
+static int generic_bytes(const AVComponentDescriptor *comp)
+{
+    return comp->depth + comp->shift > 8 ? 2 : 1;
+}
+
+static int generic_layout(const AVPixFmtDescriptor *desc,
+                          const AVComponentDescriptor *comp)
+{
+    if (generic_bytes(comp) == 1)
+        return 0;
+    return desc->flags & AV_PIX_FMT_FLAG_BE ? 2 : 1;
+}
+
+/* Map the Y, U, V, A components to the pixdesc component indices. */
+static void generic_comp_map(const AVPixFmtDescriptor *desc, int map[4])
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+        map[i] = -1;
+    map[GENERIC_COMP_Y] = 0;
+    if (desc->nb_components >= 3) {
+        map[GENERIC_COMP_U] = 1;
+        map[GENERIC_COMP_V] = 2;
+    }
+    if (desc->flags & AV_PIX_FMT_FLAG_ALPHA)
+        map[GENERIC_COMP_A] = desc->nb_components - 1;
+}
+
+static int generic_fmt_supported(const AVPixFmtDescriptor *desc)
+{
+    int i;
+
+    if (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                       AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB |
+                       AV_PIX_FMT_FLAG_BAYER | AV_PIX_FMT_FLAG_FLOAT))
+        return 0;
+    for (i = 0; i < desc->nb_components; i++) {
+        const AVComponentDescriptor *comp = &desc->comp[i];
+        if (comp->depth + comp->shift > 16)
+            return 0;
+        if (generic_bytes(comp) == 2 && (comp->step & 1 || comp->offset & 1))
+            return 0;
+    }
+    return 1;
+}
+
+static int generic_unscaled_supported(SwsContext *c)
+{
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(c->srcFormat);
+    const AVPixFmtDescriptor *dst = av_pix_fmt_desc_get(c->dstFormat);
+
+    if (c->flags & SWS_BITEXACT ||
+        !generic_fmt_supported(src) || !generic_fmt_supported(dst))
+        return 0;
+    if (src->nb_components >= 3 && dst->nb_components >= 3 &&
+        (src->log2_chroma_w != dst->log2_chroma_w ||
+         src->log2_chroma_h != dst->log2_chroma_h))
+        return 0;
+    return 1;
+}
+
+static uint16_t *generic_range_lut(int src_depth, int dst_depth,
+                                   int to_full, int chroma)
+{
+    uint16_t *lut = av_malloc_array(1 << src_depth, sizeof(*lut));
+    const int max = (1 << dst_depth) - 1;
+    int i;
+
+    if (!lut)
+        return NULL;
+    for (i = 0; i < 1 << src_depth; i++) {
+        /* work in 8-bit units */
+        double x = ldexp(i, 8 - src_depth), y;
+        if (chroma)
+            y = to_full ? (x - 128) * 255 / 224 + 128 : (x - 128) * 224 / 255 + 128;
+        else
+            y = to_full ? (x - 16) * 255 / 219 : x * 219 / 255 + 16;
+        lut[i] = av_clip(lrint(ldexp(y, dst_depth - 8)), 0, max);
+    }
+    return lut;
+}
+
+static int genericUnscaledWrapper(SwsContext *c, const uint8_t *src[],
+                                  int srcStride[], int srcSliceY,
+                                  int srcSliceH, uint8_t *dst[],
+                                  int dstStride[])
+{
+    const AVPixFmtDescriptor *src_desc = av_pix_fmt_desc_get(c->srcFormat);
+    const AVPixFmtDescriptor *dst_desc = av_pix_fmt_desc_get(c->dstFormat);
+    int src_map[4], dst_map[4];
+    int k, y;
+
+    generic_comp_map(src_desc, src_map);
+    generic_comp_map(dst_desc, dst_map);
+
+    for (k = 0; k < 4; k++) {
+        const AVComponentDescriptor *dc, *sc = NULL;
+        const int chroma = k == GENERIC_COMP_U || k == GENERIC_COMP_V;
+        const int log2_w = chroma ? dst_desc->log2_chroma_w : 0;
+        const int log2_h = chroma ? dst_desc->log2_chroma_h : 0;
+        const int width  = AV_CEIL_RSHIFT(c->srcW, log2_w);
+        const int dst_layout = dst_map[k] >= 0 ? generic_layout(dst_desc, &dst_desc->comp[dst_map[k]]) : 0;
+        generic_line_fn line_fn = NULL;
+        GenericComp p = { 0 };
+        unsigned fill = 0;
+
+        if (dst_map[k] < 0)
+            continue;
+        dc = &dst_desc->comp[dst_map[k]];
+        p.dst_step  = dc->step;
+        p.dst_shift = dc->shift;
+
+        if (src_map[k] >= 0) {
+            sc = &src_desc->comp[src_map[k]];
+            p.src_step  = sc->step;
+            p.src_shift = sc->shift;
+            p.src_mask  = (1U << sc->depth) - 1;
+            p.max       = (1U << dc->depth) - 1;
+            p.lshift    = FFMAX(dc->depth - sc->depth, 0);
+            p.rshift    = FFMAX(sc->depth - dc->depth, 0);
+            /* like planarCopyWrapper(), replicate the high bits into the
+             * new low bits of full range luma and alpha */
+            if (p.lshift && p.lshift <= sc->depth &&
+                (k == GENERIC_COMP_A || (k == GENERIC_COMP_Y && c->srcRange))) {
+                p.rep_shift = sc->depth - p.lshift;
+                p.rep_mask  = ~0U;
+            }
+            if (k != GENERIC_COMP_A)
+                p.lut = c->unscaled_range_lut[chroma];
+            line_fn = generic_line_fns[!!p.lut][generic_layout(src_desc, sc)][dst_layout];
+        } else if (k == GENERIC_COMP_A) {
+            fill = (1U << dc->depth) - 1;
+        } else {
+            fill = 1U << (dc->depth - 1);
+        }
+
+        for (y = srcSliceY; y < srcSliceY + srcSliceH; y++) {
+            uint8_t *out;
+
+            if (y & ((1 << log2_h) - 1))
+                continue;
+            out = dst[dc->plane] + (y >> log2_h) * dstStride[dc->plane] + dc->offset;
+
+            if (line_fn) {
+                const int src_y = (y >> log2_h) - (srcSliceY >> log2_h);
+                line_fn(out, src[sc->plane] + src_y * srcStride[sc->plane] + sc->offset,
+                        width, &p);
+            } else {
+                int x;
+                for (x = 0; x < width; x++)
+                    generic_write(out + x * dc->step, fill << dc->shift,
+                                  generic_bytes(dc), dst_layout == 2);
+            }
+        }
+    }
+
+    return srcSliceH;
+}
+
+static void get_unscaled_generic(SwsContext *c)
+{
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(c->srcFormat);
+    const AVPixFmtDescriptor *dst = av_pix_fmt_desc_get(c->dstFormat);
+    int i;
+
+    av_freep(&c->unscaled_range_lut[0]);
+    av_freep(&c->unscaled_range_lut[1]);
+
+    if (!generic_unscaled_supported(c))
+        return;
+
+    if (c->srcRange != c->dstRange) {
+        for (i = 0; i < 2; i++) {
+            /* the chroma table is only used with chroma in both formats */
+            if (i && (src->nb_components < 3 || dst->nb_components < 3))
+                break;
+            c->unscaled_range_lut[i] = generic_range_lut(src->comp[i].depth,
+                                                         dst->comp[i].depth,
+                                                         c->dstRange, i);
+            if (!c->unscaled_range_lut[i])
+                return;
+        }
+    }
+
+    c->convert_unscaled = genericUnscaledWrapper;
+}
+
+static void get_unscaled_arch(SwsContext *c)
+{
+    if (ARCH_PPC)
+        ff_get_unscaled_swscale_ppc(c);
+    if (ARCH_ARM)
+        ff_get_unscaled_swscale_arm(c);
+    if (ARCH_AARCH64)
+        ff_get_unscaled_swscale_aarch64(c);
+}
+
 void ff_get_unscaled_swscale(SwsContext *c)
 {
     const enum AVPixelFormat srcFormat = c->srcFormat;
@@ -1984,6 +2280,14 @@ void ff_get_unscaled_swscale(SwsContext *c)
             c->dstFormatBpp < 24 &&
            (c->dstFormatBpp < c->srcFormatBpp || (!isAnyRGB(srcFormat)));
 
+    /* only the generic converter handles yuv range conversion */
+    if (c->srcRange != c->dstRange && !isAnyRGB(dstFormat) &&
+        !isFloat(srcFormat) && !isFloat(dstFormat)) {
+        get_unscaled_generic(c);
+        get_unscaled_arch(c);
+        return;
+    }
+
     /* yv12_to_nv12 */
     if ((srcFormat == AV_PIX_FMT_YUV420P || srcFormat == AV_PIX_FMT_YUVA420P) &&
         (dstFormat == AV_PIX_FMT_NV12 || dstFormat == AV_PIX_FMT_NV21)) {
@@ -2222,12 +2526,10 @@ void ff_get_unscaled_swscale(SwsContext *c)
             c->convert_unscaled = planarCopyWrapper;
     }
 
-    if (ARCH_PPC)
-        ff_get_unscaled_swscale_ppc(c);
-     if (ARCH_ARM)
-         ff_get_unscaled_swscale_arm(c);
-    if (ARCH_AARCH64)
-        ff_get_unscaled_swscale_aarch64(c);
+    if (!c->convert_unscaled)
+        get_unscaled_generic(c);
+
+    get_unscaled_arch(c);
 }
 
 /* Convert the palette to the same packed 32-bit format as the palette */
@@ -0,0 +1,174 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compare the output of the generic unscaled YUV converter against the
+ * scaler, which is used instead with SWS_BITEXACT.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#define W 96
+#define H 64
+
+static const struct {
+    enum AVPixelFormat src, dst;
+    int src_range, dst_range;
+} tests[] = {
+    { AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P10LE, 0, 0 },
+    { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_P010LE,      0, 0 },
+    { AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P10LE, 0, 0 },
+    { AV_PIX_FMT_P010BE,      AV_PIX_FMT_NV12,        0, 0 },
+    { AV_PIX_FMT_YUYV422,     AV_PIX_FMT_YUV422P10LE, 0, 0 },
+    { AV_PIX_FMT_Y210LE,      AV_PIX_FMT_YUV422P10LE, 0, 0 },
+    { AV_PIX_FMT_GRAY8,       AV_PIX_FMT_GRAY10LE,    0, 0 },
+    { AV_PIX_FMT_GRAY16BE,    AV_PIX_FMT_GRAY8,       0, 0 },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,     0, 1 },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,     1, 0 },
+    { AV_PIX_FMT_NV12,        AV_PIX_FMT_P010LE,      0, 1 },
+    { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P,     1, 0 },
+    { AV_PIX_FMT_GRAY8,       AV_PIX_FMT_GRAY8,       1, 0 },
+    { AV_PIX_FMT_YUYV422,     AV_PIX_FMT_YUV422P,     0, 1 },
+};
+
+static struct SwsContext *get_context(int i, int flags)
+{
+    struct SwsContext *c = sws_alloc_context();
+
+    if (!c)
+        return NULL;
+    av_opt_set_int(c, "srcw",       W,                   0);
+    av_opt_set_int(c, "srch",       H,                   0);
+    av_opt_set_int(c, "dstw",       W,                   0);
+    av_opt_set_int(c, "dsth",       H,                   0);
+    av_opt_set_int(c, "src_format", tests[i].src,        0);
+    av_opt_set_int(c, "dst_format", tests[i].dst,        0);
+    av_opt_set_int(c, "src_range",  tests[i].src_range,  0);
+    av_opt_set_int(c, "dst_range",  tests[i].dst_range,  0);
+    av_opt_set_int(c, "sws_flags",  flags,               0);
+    if (sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+/* Largest difference between two images, in units of the lowest 8 bits. */
+static double max_diff(const AVPixFmtDescriptor *desc, uint8_t *a[4], int a_stride[4],
+                       uint8_t *b[4], int b_stride[4])
+{
+    uint32_t la[W], lb[W];
+    double ret = 0;
+
+    for (int c = 0; c < desc->nb_components; c++) {
+        int w = c == 1 || c == 2 ? AV_CEIL_RSHIFT(W, desc->log2_chroma_w) : W;
+        int h = c == 1 || c == 2 ? AV_CEIL_RSHIFT(H, desc->log2_chroma_h) : H;
+
+        for (int y = 0; y < h; y++) {
+            av_read_image_line2(la, (const uint8_t **)a, a_stride, desc, 0, y, c, w, 0, 4);
+            av_read_image_line2(lb, (const uint8_t **)b, b_stride, desc, 0, y, c, w, 0, 4);
+            for (int x = 0; x < w; x++)
+                ret = FFMAX(ret, ldexp(abs((int)la[x] - (int)lb[x]),
+                                       8 - desc->comp[c].depth));
+        }
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 1);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        const AVPixFmtDescriptor *src_desc = av_pix_fmt_desc_get(tests[i].src);
+        const AVPixFmtDescriptor *dst_desc = av_pix_fmt_desc_get(tests[i].dst);
+        struct SwsContext *test = NULL, *ref = NULL;
+        uint8_t *src[4] = { NULL }, *out[4] = { NULL }, *ref_out[4] = { NULL };
+        int src_stride[4], out_stride[4], ref_stride[4];
+        uint16_t line[W];
+        double diff;
+        int size;
+
+        printf("%s %s -> %s %s: ", src_desc->name, tests[i].src_range ? "full" : "limited",
+               dst_desc->name, tests[i].dst_range ? "full" : "limited");
+
+        test = get_context(i, SWS_POINT);
+        ref  = get_context(i, SWS_POINT | SWS_ACCURATE_RND | SWS_BITEXACT);
+        if (!test || !ref ||
+            (size = av_image_alloc(src, src_stride, W, H, tests[i].src, 16)) < 0 ||
+            av_image_alloc(out,     out_stride, W, H, tests[i].dst, 16) < 0 ||
+            av_image_alloc(ref_out, ref_stride, W, H, tests[i].dst, 16) < 0) {
+            printf("failed to allocate\n");
+            ret = 1;
+            goto next;
+        }
+        if (!test->convert_unscaled) {
+            printf("not converted unscaled\n");
+            ret = 1;
+            goto next;
+        }
+
+        /* av_write_image_line2() ORs the samples into the existing bits */
+        memset(src[0], 0, size);
+        for (int c = 0; c < src_desc->nb_components; c++) {
+            int w = c == 1 || c == 2 ? AV_CEIL_RSHIFT(W, src_desc->log2_chroma_w) : W;
+            int h = c == 1 || c == 2 ? AV_CEIL_RSHIFT(H, src_desc->log2_chroma_h) : H;
+
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++)
+                    line[x] = av_lfg_get(&lfg) & ((1 << src_desc->comp[c].depth) - 1);
+                av_write_image_line2(line, src, src_stride, src_desc, 0, y, c, w, 2);
+            }
+        }
+
+        sws_scale(test, (const uint8_t * const *)src, src_stride, 0, H, out,     out_stride);
+        sws_scale(ref,  (const uint8_t * const *)src, src_stride, 0, H, ref_out, ref_stride);
+
+        diff = max_diff(dst_desc, out, out_stride, ref_out, ref_stride);
+        printf("max diff %.2f\n", diff);
+        /* the scaler dithers and rounds differently when reducing the depth */
+        if (diff > 1) {
+            printf("difference too large\n");
+            ret = 1;
+        }
+
+next:
+        av_freep(&src[0]);
+        av_freep(&out[0]);
+        av_freep(&ref_out[0]);
+        sws_freeContext(test);
+        sws_freeContext(ref);
+    }
+
+    return ret;
+}
@@ -1267,6 +1267,7 @@ static int context_init_threaded(SwsContext *c,
         return ret;
 
     c->nb_threads = ret;
+    avpriv_slicethread_set_priority(c->slicethread, AVPRIV_SLICETHREAD_PRIORITY_SCALE);
 
     c->slice_ctx = av_calloc(c->nb_threads, sizeof(*c->slice_ctx));
     c->slice_err = av_calloc(c->nb_threads, sizeof(*c->slice_err));
@@ -1988,9 +1989,7 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     }
 
     /* unscaled special cases */
-    if (unscaled && !usesHFilter && !usesVFilter &&
-        (c->srcRange == c->dstRange || isAnyRGB(dstFormat) ||
-         isFloat(srcFormat) || isFloat(dstFormat))){
+    if (unscaled && !usesHFilter && !usesVFilter) {
         ff_get_unscaled_swscale(c);
 
         if (c->convert_unscaled) {
@@ -2412,6 +2411,9 @@ void sws_freeContext(SwsContext *c)
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
+    av_freep(&c->unscaled_range_lut[0]);
+    av_freep(&c->unscaled_range_lut[1]);
+
     av_frame_free(&c->frame_src);
     av_frame_free(&c->frame_dst);
 
@@ -0,0 +1,166 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Check that av_interleaved_write_frames() produces the same output as
+ * calling av_interleaved_write_frame() on each packet.
+ */
+
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/mem.h"
+#include "libavformat/avformat.h"
+
+#define NB_PACKETS 200
+
+/**
+ * Packets of a video stream at 25 fps and an audio stream with 1024 sample
+ * frames at 48 kHz, in dts order.
+ */
+static void make_packet(AVFormatContext *s, AVPacket *pkt, int n)
+{
+    static const AVRational time_base[2] = { { 1, 25 }, { 1, 48000 } };
+    static int64_t next_dts[2];
+    int size = 16 + (n * 37) % 200;
+    int stream;
+
+    if (!n)
+        next_dts[0] = next_dts[1] = 0;
+    stream = next_dts[1] * 25 < next_dts[0] * 48000;
+
+    av_new_packet(pkt, size);
+    for (int i = 0; i < size; i++)
+        pkt->data[i] = n + i;
+    pkt->stream_index = stream;
+    pkt->dts = pkt->pts = next_dts[stream];
+    pkt->duration       = stream ? 1024 : 1;
+    next_dts[stream]   += pkt->duration;
+    if (stream || n % 12 == 0)
+        pkt->flags |= AV_PKT_FLAG_KEY;
+    av_packet_rescale_ts(pkt, time_base[stream], s->streams[stream]->time_base);
+}
+
+static int mux(const char *format, int batch, uint8_t **out)
+{
+    AVFormatContext *s = NULL;
+    AVPacket *pkts[8] = { NULL };
+    AVStream *st;
+    int ret, n = 0;
+
+    ret = avformat_alloc_output_context2(&s, NULL, format, NULL);
+    if (ret < 0)
+        return ret;
+    s->flags |= AVFMT_FLAG_BITEXACT;
+
+    if (!(st = avformat_new_stream(s, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->time_base            = (AVRational){ 1, 25 };
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_MPEG4;
+    st->codecpar->width      = 64;
+    st->codecpar->height     = 48;
+
+    if (!(st = avformat_new_stream(s, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->time_base               = (AVRational){ 1, 48000 };
+    st->codecpar->codec_type    = AVMEDIA_TYPE_AUDIO;
+    st->codecpar->codec_id      = AV_CODEC_ID_MP2;
+    st->codecpar->sample_rate   = 48000;
+    st->codecpar->frame_size    = 1024;
+    st->codecpar->channels      = 1;
+    st->codecpar->channel_layout = AV_CH_LAYOUT_MONO;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(pkts); i++)
+        if (!(pkts[i] = av_packet_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+
+    if ((ret = avio_open_dyn_buf(&s->pb)) < 0)
+        goto end;
+    if ((ret = avformat_write_header(s, NULL)) < 0)
+        goto end;
+
+    while (n < NB_PACKETS) {
+        /* batches of 1 to 8 packets */
+        int nb = batch ? FFMIN(1 + n % FF_ARRAY_ELEMS(pkts), NB_PACKETS - n) : 1;
+
+        for (int i = 0; i < nb; i++)
+            make_packet(s, pkts[i], n + i);
+        n += nb;
+
+        if (batch)
+            ret = av_interleaved_write_frames(s, pkts, nb);
+        else
+            ret = av_interleaved_write_frame(s, pkts[0]);
+        if (ret < 0)
+            goto end;
+    }
+    ret = av_write_trailer(s);
+
+end:
+    if (s && s->pb) {
+        int size = avio_close_dyn_buf(s->pb, out);
+        s->pb = NULL;
+        if (ret >= 0)
+            ret = size;
+        else
+            av_freep(out);
+    }
+    for (int i = 0; i < FF_ARRAY_ELEMS(pkts); i++)
+        av_packet_free(&pkts[i]);
+    avformat_free_context(s);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const formats[] = { "framecrc", "nut", "matroska" };
+    int ret = 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(formats); i++) {
+        uint8_t *ref = NULL, *out = NULL;
+        int ref_size, out_size;
+
+        if (!av_guess_format(formats[i], NULL, NULL))
+            continue;
+
+        ref_size = mux(formats[i], 0, &ref);
+        out_size = mux(formats[i], 1, &out);
+        if (ref_size < 0 || out_size < 0) {
+            fprintf(stderr, "%s: muxing failed: %s\n", formats[i],
+                    av_err2str(ref_size < 0 ? ref_size : out_size));
+            ret = 1;
+        } else if (ref_size != out_size || memcmp(ref, out, ref_size)) {
+            fprintf(stderr, "%s: output differs from per-packet calls\n",
+                    formats[i]);
+            ret = 1;
+        }
+        av_free(ref);
+        av_free(out);
+    }
+
+    return ret;
+}
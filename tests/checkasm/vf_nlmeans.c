@@ -18,9 +18,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <math.h>
 #include "checkasm.h"
 #include "libavfilter/vf_nlmeans.h"
 #include "libavutil/avassert.h"
+#include "libavutil/mem_internal.h"
+
+#define WEIGHTS_LEN (128 + 8)
 
 #define randomize_buffer(buf, size) do {    \
     int i;                                  \
@@ -28,6 +32,25 @@
         ((uint32_t *)buf)[i] = rnd();       \
 } while (0)
 
+/* Fill the 4 corners of the integral image lines so that the patch
+ * differences spread around max_meaningful_diff, and a weight LUT that is 0
+ * past it like the filter's. */
+static void init_weights(uint32_t *ii, int len, float *lut, int max_meaningful_diff)
+{
+    for (int x = 0; x < len; x++) {
+        const uint32_t a = rnd();
+        const uint32_t b = rnd();
+        const uint32_t d = rnd();
+        ii[x          ] = a;
+        ii[x +     len] = b;
+        ii[x + 2 * len] = d;
+        ii[x + 3 * len] = d + b - a + rnd() % (2 * max_meaningful_diff);
+    }
+    for (int i = 0; i < max_meaningful_diff; i++)
+        lut[i] = exp(-i / 100.);
+    lut[max_meaningful_diff] = 0;
+}
+
 void checkasm_check_nlmeans(void)
 {
     NLMeansDSPContext dsp = {0};
@@ -110,4 +133,49 @@ void checkasm_check_nlmeans(void)
     }
 
     report("dsp");
+
+    if (check_func(dsp.compute_weights_line, "weights_line")) {
+        const int max_meaningful_diff = 255;
+        uint32_t *ii = av_malloc_array(4 * (w + 8), sizeof(*ii));
+        uint8_t *src = av_malloc(w + 8);
+        float *lut = av_malloc_array(max_meaningful_diff + 1, sizeof(*lut));
+        LOCAL_ALIGNED_32(float, total_ref, [WEIGHTS_LEN]);
+        LOCAL_ALIGNED_32(float, total_new, [WEIGHTS_LEN]);
+        LOCAL_ALIGNED_32(float, sum_ref, [WEIGHTS_LEN]);
+        LOCAL_ALIGNED_32(float, sum_new, [WEIGHTS_LEN]);
+
+        declare_func(void, const uint32_t *const iia,
+                     const uint32_t *const iib,
+                     const uint32_t *const iid,
+                     const uint32_t *const iie,
+                     const uint8_t *const src,
+                     float *total_weight,
+                     float *sum,
+                     const float *const weight_lut,
+                     int max_meaningful_diff,
+                     int startx, int endx);
+
+        init_weights(ii, w + 8, lut, max_meaningful_diff);
+        randomize_buffer(src, (w + 8));
+        memset(total_ref, 0, WEIGHTS_LEN * sizeof(*total_ref));
+        memset(sum_ref,   0, WEIGHTS_LEN * sizeof(*sum_ref));
+        memset(total_new, 0, WEIGHTS_LEN * sizeof(*total_new));
+        memset(sum_new,   0, WEIGHTS_LEN * sizeof(*sum_new));
+
+        call_ref(ii, ii + (w + 8), ii + 2 * (w + 8), ii + 3 * (w + 8), src,
+                 total_ref, sum_ref, lut, max_meaningful_diff, 3, w);
+        call_new(ii, ii + (w + 8), ii + 2 * (w + 8), ii + 3 * (w + 8), src,
+                 total_new, sum_new, lut, max_meaningful_diff, 3, w);
+        if (!float_near_ulp_array(total_ref, total_new, 1, w) ||
+            !float_near_ulp_array(sum_ref, sum_new, 1, w))
+            fail();
+        bench_new(ii, ii + (w + 8), ii + 2 * (w + 8), ii + 3 * (w + 8), src,
+                  total_new, sum_new, lut, max_meaningful_diff, 0, w);
+
+        av_freep(&ii);
+        av_freep(&src);
+        av_freep(&lut);
+    }
+
+    report("weights");
 }
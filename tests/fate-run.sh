@@ -171,6 +171,22 @@ md5(){
     do_md5sum $encfile | awk '{print $1}'
 }
 
+# Encode to two outputs, print their packets and the final PSNR report
+enc_psnr(){
+    opts1=$1
+    opts2=$2
+    shift 2
+    out1="${outdir}/${test}.1.framecrc"
+    out2="${outdir}/${test}.2.framecrc"
+    progfile="${outdir}/${test}.progress"
+    cleanfiles="$cleanfiles $out1 $out2 $progfile"
+    ffmpeg "$@" -psnr -progress $(target_path $progfile) \
+        $opts1 -bitexact -f framecrc -y $(target_path $out1) \
+        $opts2 -bitexact -f framecrc -y $(target_path $out2) || return
+    cat $out1 $out2
+    awk '/_psnr_/ { block = block $0 "\n" } /^progress=/ { last = block; block = "" } END { printf "%s", last }' $progfile
+}
+
 pcm(){
     ffmpeg -auto_conversion_filters "$@" -vn -f s16le -
 }
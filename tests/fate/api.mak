@@ -21,6 +21,11 @@ fate-api-seek: $(APITESTSDIR)/api-seek-test$(EXESUF) fate-lavf-flv
 fate-api-seek: CMD = run $(APITESTSDIR)/api-seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.flv 0 720
 fate-api-seek: CMP = null
 
+FATE_API_LIBAVFORMAT-$(CONFIG_FRAMECRC_MUXER) += fate-api-interleave
+fate-api-interleave: $(APITESTSDIR)/api-interleave-test$(EXESUF)
+fate-api-interleave: CMD = run $(APITESTSDIR)/api-interleave-test$(EXESUF)
+fate-api-interleave: CMP = null
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test$(EXESUF) 3 10 30 50 2 20 40
@@ -30,6 +30,13 @@ fate-ffmpeg-filter_complex: CMD = framecrc -filter_complex color=d=1:r=5 -fflags
 FATE_FFMPEG-$(call ALLYES, AEVALSRC_FILTER ASETNSAMPLES_FILTER AC3_FIXED_ENCODER) += fate-ffmpeg-filter_complex_audio
 fate-ffmpeg-filter_complex_audio: CMD = framecrc -auto_conversion_filters -filter_complex "aevalsrc=0:d=0.1,asetnsamples=1537" -c ac3_fixed
 
+# Encoding on encoder threads must give the same packets and PSNR as
+# encoding on the main thread
+FATE_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER MPEG4_ENCODER MPEG2VIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-enc-psnr fate-ffmpeg-enc-thread-psnr
+fate-ffmpeg-enc-psnr:        CMD = enc_psnr "-c:v mpeg2video -b:v 200k -bf 2 -g 12 -threads 1" "-c:v mpeg4 -qscale:v 4 -threads 1" -f lavfi -i testsrc2=s=176x144:r=25:d=2 -flags +bitexact
+fate-ffmpeg-enc-thread-psnr: CMD = enc_psnr "-c:v mpeg2video -b:v 200k -bf 2 -g 12 -threads 1" "-c:v mpeg4 -qscale:v 4 -threads 1" -f lavfi -i testsrc2=s=176x144:r=25:d=2 -flags +bitexact -enc_thread_queue_size 4
+fate-ffmpeg-enc-thread-psnr: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-enc-psnr
+
 # Ticket 6375, use case of NoX
 FATE_SAMPLES_FFMPEG-$(call ALLYES, MOV_DEMUXER PNG_DECODER ALAC_DECODER PCM_S16LE_ENCODER RAWVIDEO_ENCODER) += fate-ffmpeg-attached_pics
 fate-ffmpeg-attached_pics: CMD = threads=2 framecrc -i $(TARGET_SAMPLES)/lossless-audio/inside.m4a -c:a pcm_s16le -threads 1 -max_muxing_queue_size 16 -af aresample
@@ -140,6 +147,24 @@ FATE_STREAMCOPY-$(call ENCDEC, APNG, APNG) += fate-copy-apng
 fate-copy-apng: fate-lavf-apng
 fate-copy-apng: CMD = transcode apng tests/data/lavf/lavf.apng apng "-c:v copy"
 
+# Packets referencing the input buffer with the zerocopy fflag must give the
+# same stream copied and decoded output as copied packets
+FATE_FFMPEG-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER PCM_S16LE_ENCODER FRAMECRC_MUXER) += fate-copy-wav fate-copy-wav-zerocopy fate-decode-wav-zerocopy
+fate-copy-wav fate-copy-wav-zerocopy fate-decode-wav-zerocopy: tests/data/asynth-44100-2.wav
+fate-copy-wav:            CMD = framecrc -max_size 16384 -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -c copy
+fate-copy-wav-zerocopy:   CMD = framecrc -fflags +zerocopy -max_size 16384 -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -c copy
+fate-decode-wav-zerocopy: CMD = framecrc -fflags +zerocopy -max_size 16384 -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-copy-wav-zerocopy fate-decode-wav-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/copy-wav
+
+FATE_FFMPEG-$(call ALLYES, MPEG4_ENCODER MPEG4_DECODER PCM_ALAW_ENCODER PCM_ALAW_DECODER MOV_MUXER MOV_DEMUXER RAWVIDEO_ENCODER PCM_S16LE_ENCODER FRAMECRC_MUXER) += fate-copy-mov fate-copy-mov-zerocopy fate-decode-mov fate-decode-mov-zerocopy
+fate-copy-mov fate-copy-mov-zerocopy fate-decode-mov fate-decode-mov-zerocopy: fate-lavf-mov
+fate-copy-mov:            CMD = framecrc -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -c copy
+fate-copy-mov-zerocopy:   CMD = framecrc -fflags +zerocopy -i $(TARGET_PATH)/tests/data/lavf/lavf.mov -c copy
+fate-copy-mov-zerocopy:   REF = $(SRC_PATH)/tests/ref/fate/copy-mov
+fate-decode-mov:          CMD = framecrc -i $(TARGET_PATH)/tests/data/lavf/lavf.mov
+fate-decode-mov-zerocopy: CMD = framecrc -fflags +zerocopy -i $(TARGET_PATH)/tests/data/lavf/lavf.mov
+fate-decode-mov-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/decode-mov
+
 FATE_STREAMCOPY-$(call DEMMUX, OGG, OGG) += fate-limited_input_seek fate-limited_input_seek-copyts
 fate-limited_input_seek: $(SAMPLES)/vorbis/moog_small.ogg
 fate-limited_input_seek: CMD = md5 -ss 1.5 -t 1.3 -i $(TARGET_SAMPLES)/vorbis/moog_small.ogg -c:a copy -fflags +bitexact -f ogg
@@ -128,6 +128,22 @@ fate-filter-firequalizer: CMP = oneoff
 fate-filter-firequalizer: CMP_UNIT = s16
 fate-filter-firequalizer: SIZE_TOLERANCE = 1058400 - 1097208
 
+# afir with a unit impulse delayed by $(1) samples as IR, trimmed back by the
+# same delay, must output its input, $(2) bytes shorter. A delay of 3 lands in the direct form
+# head segment, a delay of 40 in the FFT partitions.
+define FATE_AFILTER_AFIR_TEST
+FATE_AFILTER-$(call FILTERDEMDECENCMUX, AEVALSRC AFIR ATRIM, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-afir-minp1-delay$(1)
+fate-filter-afir-minp1-delay$(1): tests/data/asynth-44100-2.wav
+fate-filter-afir-minp1-delay$(1): REF = tests/data/asynth-44100-2.wav
+fate-filter-afir-minp1-delay$(1): CMD = ffmpeg -auto_conversion_filters -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -filter_complex "aevalsrc=eq(n\\,$(1)):c=stereo:s=44100:d=0.002[ir];[0:a][ir]afir=gtype=none:minp=1:maxp=16,atrim=start_sample=$(1)" -f wav -c:a pcm_s16le -
+fate-filter-afir-minp1-delay$(1): CMP = oneoff
+fate-filter-afir-minp1-delay$(1): CMP_UNIT = s16
+fate-filter-afir-minp1-delay$(1): SIZE_TOLERANCE = $(2)
+endef
+
+$(eval $(call FATE_AFILTER_AFIR_TEST,3,12))
+$(eval $(call FATE_AFILTER_AFIR_TEST,40,160))
+
 FATE_AFILTER-$(call FILTERDEMDECENCMUX, PAN, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-pan-mono1
 fate-filter-pan-mono1: tests/data/asynth-44100-2.wav
 fate-filter-pan-mono1: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
@@ -74,6 +74,18 @@ fate-filter-lavd-life: CMD = framecrc -f lavfi -i life=s=40x40:r=5:seed=42:mold=
 FATE_FILTER-$(call ALLYES, AVDEVICE TESTSRC_FILTER) += fate-filter-lavd-testsrc
 fate-filter-lavd-testsrc: CMD = framecrc -f lavfi -i testsrc=r=7:n=2:d=10
 
+FILTER_BRANCHES = testsrc2=s=176x144:r=7:d=2,format=yuv420p,split=4[a][b][c][d];[a]hflip[oa];[b]vflip,negate[ob];[c]transpose[oc];[d]gblur=sigma=2[od]
+FILTER_BRANCHES_OPTS = -filter_complex "$(FILTER_BRANCHES)" -map "[oa]" -map "[ob]" -map "[oc]" -map "[od]"
+
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FORMAT_FILTER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER NEGATE_FILTER TRANSPOSE_FILTER GBLUR_FILTER) += fate-filter-branches fate-filter-branches-thread
+fate-filter-branches: CMD = framecrc -filter_complex_threads 1 $(FILTER_BRANCHES_OPTS)
+fate-filter-branches-thread: CMD = framecrc -filter_complex_threads 4 -filter_complex_thread_type slice+branch $(FILTER_BRANCHES_OPTS)
+fate-filter-branches-thread: REF = $(SRC_PATH)/tests/ref/fate/filter-branches
+
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FORMAT_FILTER NOISE_FILTER NLMEANS_FILTER SCALE_FILTER) += fate-filter-nlmeans-yuv420p10 fate-filter-nlmeans-yuv444p16
+fate-filter-nlmeans-yuv420p10: CMD = framecrc -lavfi testsrc2=s=160x120:r=5:d=1,format=yuv420p,noise=alls=12:allf=t,scale,format=yuv420p10,nlmeans=s=3:p=3:r=9 -pix_fmt yuv420p10le
+fate-filter-nlmeans-yuv444p16: CMD = framecrc -lavfi testsrc2=s=160x120:r=5:d=1,format=yuv444p16,noise=alls=12:allf=t,nlmeans=s=3:p=3:r=9 -pix_fmt yuv444p16le
+
 FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER) += fate-filter-testsrc2-yuv420p
 fate-filter-testsrc2-yuv420p: CMD = framecrc -lavfi testsrc2=r=7:d=10 -pix_fmt yuv420p
 
@@ -199,7 +199,27 @@ FATE_H264  := $(FATE_H264:%=fate-h264-conformance-%)                    \
               fate-h264-timecode                                        \
               fate-h264-encparams
 
+# Single slice pictures reconstructed on a second slice thread must match
+# serial decoding
+define FATE_H264_RECON_PIPELINE_TEST
+FATE_H264_RECON_PIPELINE += fate-h264-recon-pipeline-$(1)
+fate-h264-recon-pipeline-$(1): CMD = threads=2 thread_type=slice framecrc -recon_pipeline 1 -i $(TARGET_SAMPLES)/h264-conformance/$(2)
+fate-h264-recon-pipeline-$(1): REF = $(SRC_PATH)/tests/ref/fate/h264-conformance-$(1)
+endef
+
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,ba1_sony_d,BA1_Sony_D.jsv))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,canl1_toshiba_g,CANL1_TOSHIBA_G.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,cvpcmnl1_sva_c,CVPCMNL1_SVA_C.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,caba1_sva_b,CABA1_SVA_B.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,caba3_sva_b,CABA3_SVA_B.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,capcm1_sand_e,CAPCM1_Sand_E.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,cabac_mot_frm0_full,camp_mot_frm0_full.26l))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,frext-hpcv_brcm_a,FRext/HPCV_BRCM_A.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,frext-hpca_brcm_c,FRext/HPCA_BRCM_C.264))
+$(eval $(call FATE_H264_RECON_PIPELINE_TEST,frext-hcaff1_hhi_b,FRext/HCAFF1_HHI.264))
+
 FATE_H264-$(call DEMDEC, H264, H264) += $(FATE_H264)
+FATE_H264-$(call DEMDEC, H264, H264) += $(FATE_H264_RECON_PIPELINE)
 FATE_H264-$(call DEMDEC,  MOV, H264) += fate-h264-crop-to-container
 
 # this sample has two stsd entries and needs to reload extradata
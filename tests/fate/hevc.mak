@@ -230,7 +230,17 @@ FATE_HEVC_LARGE += fate-hevc-conformance-$(1)
 fate-hevc-conformance-$(1): CMD = framecrc -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt yuv444p12le -vf scale
 endef
 
+# WPP row threads inside frame threads must match single threaded decoding
+define FATE_HEVC_WPP_FRAME_TEST
+FATE_HEVC += fate-hevc-wpp-frame-$(1)
+fate-hevc-wpp-frame-$(1): CMD = threads=2 thread_type=frame framecrc -wpp_threads 3 -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(1).bit -pix_fmt yuv420p
+fate-hevc-wpp-frame-$(1): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(1)
+endef
+
+HEVC_SAMPLES_WPP = $(filter WPP_%_ericsson_MAIN_2,$(HEVC_SAMPLES))
+
 $(foreach N,$(HEVC_SAMPLES),$(eval $(call FATE_HEVC_TEST,$(N))))
+$(foreach N,$(HEVC_SAMPLES_WPP),$(eval $(call FATE_HEVC_WPP_FRAME_TEST,$(N))))
 $(foreach N,$(HEVC_SAMPLES_10BIT),$(eval $(call FATE_HEVC_TEST_10BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_422_10BIT),$(eval $(call FATE_HEVC_TEST_422_10BIT,$(N))))
 $(foreach N,$(HEVC_SAMPLES_422_10BIN),$(eval $(call FATE_HEVC_TEST_422_10BIN,$(N))))
@@ -33,7 +33,13 @@ FATE_MOV_FFPROBE = fate-mov-neg-firstpts-discard \
 
 FATE_MOV_FASTSTART = fate-mov-faststart-4gb-overflow \
 
-FATE_SAMPLES_AVCONV += $(FATE_MOV)
+# Same as the tests of the same name without -zerocopy, with packets
+# referencing the input buffer
+FATE_MOV_ZEROCOPY = fate-mov-3elist-zerocopy \
+                    fate-mov-3elist-encrypted-zerocopy \
+                    fate-mov-gpmf-remux-zerocopy \
+
+FATE_SAMPLES_AVCONV += $(FATE_MOV) $(FATE_MOV_ZEROCOPY)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
 FATE_SAMPLES_FASTSTART += $(FATE_MOV_FASTSTART)
 
@@ -114,6 +120,14 @@ fate-mov-gpmf-remux: CMD = md5 -i $(TARGET_SAMPLES)/mov/fake-gp-media-with-real-
 fate-mov-gpmf-remux: CMP = oneline
 fate-mov-gpmf-remux: REF = 6361cf3c2b9e6962c2eafbda138125f4
 
+fate-mov-3elist-zerocopy: CMD = framemd5 -fflags +zerocopy -i $(TARGET_SAMPLES)/mov/mov-3elist.mov
+fate-mov-3elist-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/mov-3elist
+fate-mov-3elist-encrypted-zerocopy: CMD = framemd5 -fflags +zerocopy -decryption_key 12345678901234567890123456789012 -i $(TARGET_SAMPLES)/mov/mov-3elist-encrypted.mov
+fate-mov-3elist-encrypted-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/mov-3elist-encrypted
+fate-mov-gpmf-remux-zerocopy: CMD = md5 -fflags +zerocopy -i $(TARGET_SAMPLES)/mov/fake-gp-media-with-real-gpmf.mp4 -map 0 -c copy -fflags +bitexact -f mp4
+fate-mov-gpmf-remux-zerocopy: CMP = oneline
+fate-mov-gpmf-remux-zerocopy: REF = 6361cf3c2b9e6962c2eafbda138125f4
+
 fate-mov-guess-delay-1: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=has_b_frames -select_streams v $(TARGET_SAMPLES)/h264/h264_3bf_nopyramid_nobsrestriction.mp4
 fate-mov-guess-delay-2: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=has_b_frames -select_streams v $(TARGET_SAMPLES)/h264/h264_3bf_pyramid_nobsrestriction.mp4
 fate-mov-guess-delay-3: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=has_b_frames -select_streams v $(TARGET_SAMPLES)/h264/h264_4bf_pyramid_nobsrestriction.mp4
@@ -132,6 +132,13 @@ int main(int argc, char **argv)
     avio_flush(output);
     avio_close(output);
 
+    if (verbose) {
+        int64_t elapsed = av_gettime_relative() - start_time;
+        fprintf(stderr, "aviocat: %"PRId64" bytes in %.3f s, %.1f MB/s\n",
+                stream_pos, elapsed / 1000000.0,
+                elapsed ? stream_pos / (double)elapsed : 0.0);
+    }
+
 fail:
     av_dict_free(&in_opts);
     av_dict_free(&out_opts);